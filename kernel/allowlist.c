@@ -4,12 +4,17 @@
 #include <linux/compiler.h>
 #include <linux/fs.h>
 #include <linux/gfp.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/printk.h>
+#include <linux/rcupdate.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/types.h>
 #include <linux/version.h>
+#include <linux/vmalloc.h>
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
 #include <linux/sched/task.h>
 #else
@@ -20,6 +25,7 @@
 #endif
 
 #include "klog.h" // IWYU pragma: keep
+#include "ksu_trace.h"
 #include "ksud.h"
 #include "selinux/selinux.h"
 #include "allowlist.h"
@@ -42,6 +48,19 @@ static DEFINE_MUTEX(allowlist_mutex);
 static struct root_profile default_root_profile;
 static struct non_root_profile default_non_root_profile;
 
+// compiled root profiles, indexed by uid so escalation doesn't walk the list
+struct root_tmpl_node {
+    uid_t uid;
+    struct root_cred_template *tmpl; // NULL: compile failed, build on demand
+    struct hlist_node hash;
+    struct rcu_head rcu;
+};
+
+#define ROOT_TMPL_HASH_BITS 6
+static DEFINE_HASHTABLE(root_tmpl_table, ROOT_TMPL_HASH_BITS);
+static DEFINE_SPINLOCK(root_tmpl_lock);
+static struct root_cred_template __rcu *default_root_tmpl;
+
 static int allow_list_arr[PAGE_SIZE / sizeof(int)] __read_mostly
     __aligned(PAGE_SIZE);
 static int allow_list_pointer __read_mostly = 0;
@@ -92,30 +111,395 @@ static void init_default_profiles(void)
     default_non_root_profile.umount_modules = true;
 }
 
+// Interned string, every key and template name is stored once
+struct pool_str {
+    struct hlist_node hash;
+    u32 hash_key;
+    int refs; // protected by profile_pool_lock
+    char str[];
+};
+
+// Root profile shared by every entry with the same content and template,
+// compiled once for all of them
+struct shared_root_profile {
+    struct hlist_node hash;
+    u32 hash_key;
+    int refs; // protected by profile_pool_lock
+    const char *template_name; // interned
+    struct root_cred_template *tmpl; // NULL: compile failed, build on demand
+    struct root_profile profile;
+};
+
+#define PROFILE_POOL_HASH_BITS 8
+static DEFINE_HASHTABLE(str_pool, PROFILE_POOL_HASH_BITS);
+static DEFINE_HASHTABLE(root_profile_pool, PROFILE_POOL_HASH_BITS);
+// _bh: entries are released from RCU callbacks too
+static DEFINE_SPINLOCK(profile_pool_lock);
+
+// Compact form of struct app_profile, expanded again when read back.
+// Entries are never modified once on allow_list: writers hold
+// allowlist_mutex and replace them, readers walk the list under RCU.
 struct perm_data {
     struct list_head list;
-    struct app_profile profile;
+    struct rcu_head rcu;
+    const char *key; // interned
+    uid_t uid;
+    u32 version;
+    bool allow_su;
+    bool use_default;
+    union {
+        struct shared_root_profile *root; // allow_su
+        struct non_root_profile non_root; // !allow_su
+    };
 };
 
 static struct list_head allow_list;
 
+static const char *intern_str(const char *s)
+{
+    size_t len = strnlen(s, KSU_MAX_PACKAGE_NAME - 1);
+    u32 hash = jhash(s, len, 0);
+    struct pool_str *node, *new_node;
+
+    new_node = kmalloc(sizeof(*new_node) + len + 1, GFP_KERNEL);
+    if (!new_node)
+        return NULL;
+    memcpy(new_node->str, s, len);
+    new_node->str[len] = '\0';
+    new_node->hash_key = hash;
+    new_node->refs = 1;
+
+    spin_lock_bh(&profile_pool_lock);
+    hash_for_each_possible (str_pool, node, hash, hash) {
+        if (node->hash_key == hash && !strcmp(node->str, new_node->str)) {
+            node->refs++;
+            spin_unlock_bh(&profile_pool_lock);
+            kfree(new_node);
+            return node->str;
+        }
+    }
+    hash_add(str_pool, &new_node->hash, hash);
+    spin_unlock_bh(&profile_pool_lock);
+
+    return new_node->str;
+}
+
+static void put_str(const char *s)
+{
+    struct pool_str *node = container_of((char *)s, struct pool_str, str[0]);
+    bool last;
+
+    spin_lock_bh(&profile_pool_lock);
+    last = --node->refs == 0;
+    if (last)
+        hash_del(&node->hash);
+    spin_unlock_bh(&profile_pool_lock);
+
+    if (last)
+        kfree(node);
+}
+
+static struct shared_root_profile *
+find_shared_root_profile_locked(u32 hash, const char *template_name,
+                                const struct root_profile *profile)
+{
+    struct shared_root_profile *node;
+
+    hash_for_each_possible (root_profile_pool, node, hash, hash) {
+        if (node->hash_key == hash && node->template_name == template_name &&
+            !memcmp(&node->profile, profile, sizeof(*profile)))
+            return node;
+    }
+
+    return NULL;
+}
+
+// Copy of src with padding, unused groups and the bytes after the domain
+// zeroed, so equal profiles hash and compare equal
+static void normalize_root_profile(struct root_profile *dst,
+                                   const struct root_profile *src)
+{
+    memset(dst, 0, sizeof(*dst));
+    dst->uid = src->uid;
+    dst->gid = src->gid;
+    dst->groups_count = src->groups_count;
+    memcpy(dst->groups, src->groups,
+           clamp_t(int, src->groups_count, 0, KSU_MAX_GROUPS) *
+               sizeof(src->groups[0]));
+    dst->capabilities.effective = src->capabilities.effective;
+    dst->capabilities.permitted = src->capabilities.permitted;
+    dst->capabilities.inheritable = src->capabilities.inheritable;
+    strscpy(dst->selinux_domain, src->selinux_domain,
+            sizeof(dst->selinux_domain));
+    dst->namespaces = src->namespaces;
+}
+
+static struct shared_root_profile *
+get_shared_root_profile(const struct app_profile *app)
+{
+    struct shared_root_profile *node, *new_node;
+    struct root_profile *profile;
+    const char *template_name;
+    u32 hash;
+
+    profile = kmalloc(sizeof(*profile), GFP_KERNEL);
+    if (!profile)
+        return NULL;
+    normalize_root_profile(profile, &app->rp_config.profile);
+
+    template_name = intern_str(app->rp_config.template_name);
+    if (!template_name) {
+        kfree(profile);
+        return NULL;
+    }
+    // interned, so the name pointer identifies the template
+    hash = jhash(profile, sizeof(*profile), (u32)(uintptr_t)template_name);
+
+    spin_lock_bh(&profile_pool_lock);
+    node = find_shared_root_profile_locked(hash, template_name, profile);
+    if (node)
+        node->refs++;
+    spin_unlock_bh(&profile_pool_lock);
+    if (node)
+        goto drop_name;
+
+    new_node = kzalloc(sizeof(*new_node), GFP_KERNEL);
+    if (!new_node)
+        goto drop_name;
+    new_node->hash_key = hash;
+    new_node->refs = 1;
+    new_node->template_name = template_name;
+    memcpy(&new_node->profile, profile, sizeof(*profile));
+    new_node->tmpl = ksu_compile_root_profile(profile);
+
+    spin_lock_bh(&profile_pool_lock);
+    node = find_shared_root_profile_locked(hash, template_name, profile);
+    if (node)
+        node->refs++;
+    else
+        hash_add(root_profile_pool, &new_node->hash, hash);
+    spin_unlock_bh(&profile_pool_lock);
+    if (!node) {
+        kfree(profile);
+        return new_node;
+    }
+
+    // lost a race against the same profile
+    ksu_put_root_cred_template(new_node->tmpl);
+    kfree(new_node);
+drop_name:
+    put_str(template_name);
+    kfree(profile);
+    return node;
+}
+
+static void put_shared_root_profile(struct shared_root_profile *node)
+{
+    bool last;
+
+    spin_lock_bh(&profile_pool_lock);
+    last = --node->refs == 0;
+    if (last)
+        hash_del(&node->hash);
+    spin_unlock_bh(&profile_pool_lock);
+
+    if (!last)
+        return;
+    ksu_put_root_cred_template(node->tmpl);
+    put_str(node->template_name);
+    kfree(node);
+}
+
+// Fill p from profile, p is left untouched on failure
+static bool fill_perm_data(struct perm_data *p,
+                           const struct app_profile *profile)
+{
+    struct shared_root_profile *root = NULL;
+    const char *key;
+
+    key = intern_str(profile->key);
+    if (!key)
+        return false;
+
+    if (profile->allow_su) {
+        root = get_shared_root_profile(profile);
+        if (!root) {
+            put_str(key);
+            return false;
+        }
+    }
+
+    p->key = key;
+    p->uid = profile->current_uid;
+    p->version = profile->version;
+    p->allow_su = profile->allow_su;
+    if (profile->allow_su) {
+        p->use_default = profile->rp_config.use_default;
+        p->root = root;
+    } else {
+        p->use_default = profile->nrp_config.use_default;
+        p->non_root = profile->nrp_config.profile;
+    }
+
+    return true;
+}
+
+static void release_perm_data(struct perm_data *p)
+{
+    put_str(p->key);
+    if (p->allow_su)
+        put_shared_root_profile(p->root);
+}
+
+static void free_perm_data_rcu(struct rcu_head *rcu)
+{
+    struct perm_data *p = container_of(rcu, struct perm_data, rcu);
+
+    release_perm_data(p);
+    kfree(p);
+}
+
+static void expand_perm_data(const struct perm_data *p,
+                             struct app_profile *profile)
+{
+    memset(profile, 0, sizeof(*profile));
+    profile->version = p->version;
+    strscpy(profile->key, p->key, sizeof(profile->key));
+    profile->current_uid = p->uid;
+    profile->allow_su = p->allow_su;
+    if (p->allow_su) {
+        profile->rp_config.use_default = p->use_default;
+        strscpy(profile->rp_config.template_name, p->root->template_name,
+                sizeof(profile->rp_config.template_name));
+        memcpy(&profile->rp_config.profile, &p->root->profile,
+               sizeof(profile->rp_config.profile));
+    } else {
+        profile->nrp_config.use_default = p->use_default;
+        profile->nrp_config.profile = p->non_root;
+    }
+}
+
+// first entry of the uid with its own root profile, under RCU
+static struct shared_root_profile *find_root_profile(uid_t uid)
+{
+    struct perm_data *p = NULL;
+
+    list_for_each_entry_rcu (p, &allow_list, list) {
+        if (p->uid == uid && p->allow_su && !p->use_default)
+            return p->root;
+    }
+
+    return NULL;
+}
+
+static void free_root_tmpl_node_rcu(struct rcu_head *rcu)
+{
+    struct root_tmpl_node *node = container_of(rcu, struct root_tmpl_node, rcu);
+
+    ksu_put_root_cred_template(node->tmpl);
+    kfree(node);
+}
+
+static void refresh_default_root_template(void)
+{
+    struct root_cred_template *tmpl, *old;
+
+    tmpl = ksu_compile_root_profile(&default_root_profile);
+
+    spin_lock(&root_tmpl_lock);
+    old = rcu_dereference_protected(default_root_tmpl,
+                                    lockdep_is_held(&root_tmpl_lock));
+    rcu_assign_pointer(default_root_tmpl, tmpl);
+    spin_unlock(&root_tmpl_lock);
+
+    ksu_put_root_cred_template(old);
+}
+
+// Recompile the template of an uid, must be called whenever a profile of
+// that uid changed. Follows the same rule as ksu_get_root_profile.
+static void refresh_root_template(uid_t uid)
+{
+    struct shared_root_profile *root;
+    struct root_tmpl_node *node, *old = NULL;
+    struct root_tmpl_node *new_node;
+
+    new_node = kzalloc(sizeof(*new_node), GFP_KERNEL);
+
+    rcu_read_lock();
+    root = find_root_profile(uid);
+    if (root && new_node) {
+        new_node->uid = uid;
+        if (root->tmpl && ksu_tryget_root_cred_template(root->tmpl))
+            new_node->tmpl = root->tmpl;
+    }
+    rcu_read_unlock();
+
+    if (!root) {
+        kfree(new_node);
+        new_node = NULL;
+    } else if (!new_node) {
+        pr_err("refresh root template alloc failed\n");
+    }
+
+    spin_lock(&root_tmpl_lock);
+    hash_for_each_possible (root_tmpl_table, node, hash, uid) {
+        if (node->uid == uid) {
+            old = node;
+            break;
+        }
+    }
+    if (old)
+        hash_del_rcu(&old->hash);
+    if (new_node)
+        hash_add_rcu(root_tmpl_table, &new_node->hash, uid);
+    spin_unlock(&root_tmpl_lock);
+
+    if (old)
+        call_rcu(&old->rcu, free_root_tmpl_node_rcu);
+}
+
+struct root_cred_template *ksu_get_root_cred_template(uid_t uid)
+{
+    struct root_tmpl_node *node;
+    struct root_cred_template *tmpl = NULL;
+    bool found = false;
+
+    rcu_read_lock();
+    hash_for_each_possible_rcu (root_tmpl_table, node, hash, uid) {
+        if (node->uid == uid) {
+            tmpl = node->tmpl;
+            found = true;
+            break;
+        }
+    }
+    if (!found)
+        tmpl = rcu_dereference(default_root_tmpl);
+    if (tmpl && !ksu_tryget_root_cred_template(tmpl))
+        tmpl = NULL;
+    rcu_read_unlock();
+
+    return tmpl;
+}
+
 static uint8_t allow_list_bitmap[PAGE_SIZE] __read_mostly __aligned(PAGE_SIZE);
 #define BITMAP_UID_MAX ((sizeof(allow_list_bitmap) * BITS_PER_BYTE) - 1)
 
 #define KERNEL_SU_ALLOWLIST "/data/adb/ksu/.allowlist"
 
 void persistent_allow_list(void);
+static void refresh_uid_policy_locked(void);
 
 void ksu_show_allow_list(void)
 {
     struct perm_data *p = NULL;
     struct list_head *pos = NULL;
     pr_info("ksu_show_allow_list\n");
-    list_for_each (pos, &allow_list) {
+    rcu_read_lock();
+    list_for_each_rcu (pos, &allow_list) {
         p = list_entry(pos, struct perm_data, list);
-        pr_info("uid :%d, allow: %d\n", p->profile.current_uid,
-                p->profile.allow_su);
+        pr_info("uid :%d, allow: %d\n", p->uid, p->allow_su);
     }
+    rcu_read_unlock();
 }
 
 #ifdef CONFIG_KSU_DEBUG
@@ -133,25 +517,30 @@ static void ksu_grant_root_to_shell(void)
 }
 #endif
 
-bool ksu_get_app_profile(struct app_profile *profile)
+// first entry of the uid, whatever its key, under RCU
+static struct perm_data *find_perm_data(uid_t uid)
 {
     struct perm_data *p = NULL;
-    struct list_head *pos = NULL;
-    bool found = false;
-    bool uid_match = false;
 
-    list_for_each (pos, &allow_list) {
-        p = list_entry(pos, struct perm_data, list);
-        uid_match = profile->current_uid == p->profile.current_uid;
-        if (uid_match) {
-            // found it, override it with ours
-            memcpy(profile, &p->profile, sizeof(*profile));
-            found = true;
-            goto exit;
-        }
+    list_for_each_entry_rcu (p, &allow_list, list) {
+        if (p->uid == uid)
+            return p;
     }
 
-exit:
+    return NULL;
+}
+
+bool ksu_get_app_profile(struct app_profile *profile)
+{
+    struct perm_data *found;
+
+    rcu_read_lock();
+    found = find_perm_data(profile->current_uid);
+    // found it, override it with ours
+    if (found)
+        expand_perm_data(found, profile);
+    rcu_read_unlock();
+
     return found;
 }
 
@@ -197,26 +586,34 @@ bool ksu_set_app_profile(struct app_profile *profile, bool persist)
         return false;
     }
 
+    mutex_lock(&allowlist_mutex);
     list_for_each (pos, &allow_list) {
         p = list_entry(pos, struct perm_data, list);
         // both uid and package must match, otherwise it will break multiple package with different user id
-        if (profile->current_uid == p->profile.current_uid &&
-            !strcmp(profile->key, p->profile.key)) {
+        if (profile->current_uid == p->uid && !strcmp(profile->key, p->key)) {
             // found it, just override it all!
-            memcpy(&p->profile, profile, sizeof(*profile));
-            result = true;
+            struct perm_data *np = kzalloc(sizeof(*np), GFP_KERNEL);
+
+            if (!np || !fill_perm_data(np, profile)) {
+                pr_err("ksu_set_app_profile alloc failed\n");
+                kfree(np);
+                goto unlock;
+            }
+            // readers may still hold the old one
+            list_replace_rcu(&p->list, &np->list);
+            call_rcu(&p->rcu, free_perm_data_rcu);
             goto out;
         }
     }
 
     // not found, alloc a new node!
     p = (struct perm_data *)kzalloc(sizeof(struct perm_data), GFP_KERNEL);
-    if (!p) {
+    if (!p || !fill_perm_data(p, profile)) {
         pr_err("ksu_set_app_profile alloc failed\n");
-        return false;
+        kfree(p);
+        goto unlock;
     }
 
-    memcpy(&p->profile, profile, sizeof(*profile));
     if (profile->allow_su) {
         pr_info("set root profile, key: %s, uid: %d, gid: %d, context: %s\n",
                 profile->key, profile->current_uid,
@@ -227,9 +624,11 @@ bool ksu_set_app_profile(struct app_profile *profile, bool persist)
                 profile->key, profile->current_uid,
                 profile->nrp_config.profile.umount_modules);
     }
-    list_add_tail(&p->list, &allow_list);
+    list_add_tail_rcu(&p->list, &allow_list);
 
 out:
+    trace_ksu_allowlist_change(KSU_ALLOWLIST_SET, profile->key,
+                               profile->current_uid, profile->allow_su);
     if (profile->current_uid <= BITMAP_UID_MAX) {
         if (profile->allow_su)
             allow_list_bitmap[profile->current_uid / BITS_PER_BYTE] |=
@@ -246,7 +645,8 @@ out:
             if (allow_list_pointer >= ARRAY_SIZE(allow_list_arr)) {
                 pr_err("too many apps registered\n");
                 WARN_ON(1);
-                return false;
+                // the list already changed, the caches must follow it
+                goto refresh;
             }
             allow_list_arr[allow_list_pointer++] = profile->current_uid;
         } else {
@@ -266,9 +666,16 @@ out:
         // set default root profile
         memcpy(&default_root_profile, &profile->rp_config.profile,
                sizeof(default_root_profile));
+        refresh_default_root_template();
     }
 
-    if (persist) {
+refresh:
+    refresh_root_template(profile->current_uid);
+    refresh_uid_policy_locked();
+unlock:
+    mutex_unlock(&allowlist_mutex);
+
+    if (result && persist) {
         persistent_allow_list();
 #ifdef KSU_TP_HOOK
         // FIXME: use a new flag
@@ -279,7 +686,7 @@ out:
     return result;
 }
 
-bool __ksu_is_allow_uid(uid_t uid)
+static bool uid_in_allow_list(uid_t uid)
 {
     int i;
 
@@ -306,58 +713,235 @@ bool __ksu_is_allow_uid(uid_t uid)
     return false;
 }
 
-bool __ksu_is_allow_uid_for_current(uid_t uid)
-{
-    if (unlikely(uid == 0)) {
-        // already root, but only allow our domain.
-        return is_ksu_domain();
-    }
-    return __ksu_is_allow_uid(uid);
-}
-
-bool ksu_uid_should_umount(uid_t uid)
+static bool uid_should_umount(uid_t uid, const struct perm_data *p)
 {
-    struct app_profile profile = { .current_uid = uid };
-    bool found = false;
-
     if (likely(ksu_is_manager_uid(uid))) {
         // we should not umount on manager!
         return false;
     }
-    found = ksu_get_app_profile(&profile);
-    if (!found) {
+    if (!p) {
         // no app profile found, it must be non root app
         return default_non_root_profile.umount_modules;
     }
-    if (profile.allow_su) {
+    if (p->allow_su) {
         // if found and it is granted to su, we shouldn't umount for it
         return false;
     } else {
         // found an app profile
-        if (profile.nrp_config.use_default) {
+        if (p->use_default) {
             return default_non_root_profile.umount_modules;
         } else {
-            return profile.nrp_config.profile.umount_modules;
+            return p->non_root.umount_modules;
         }
     }
 }
 
-struct root_profile *ksu_get_root_profile(uid_t uid)
+// The policy of an uid straight from the lists, the table caches this
+static u8 compute_uid_policy(uid_t uid)
 {
-    struct perm_data *p = NULL;
-    struct list_head *pos = NULL;
+    struct perm_data *p;
+    u8 policy = 0;
+
+    if (ksu_is_manager_uid(uid))
+        policy |= KSU_UID_POLICY_MANAGER;
+    if (uid_in_allow_list(uid))
+        policy |= KSU_UID_POLICY_ALLOW_SU;
+
+    rcu_read_lock();
+    p = find_perm_data(uid);
+    if (uid_should_umount(uid, p))
+        policy |= KSU_UID_POLICY_UMOUNT;
+    if (!p)
+        policy |= KSU_UID_POLICY_DEFAULT;
+    rcu_read_unlock();
+
+    return policy;
+}
 
-    list_for_each (pos, &allow_list) {
-        p = list_entry(pos, struct perm_data, list);
-        if (uid == p->profile.current_uid && p->profile.allow_su) {
-            if (!p->profile.rp_config.use_default) {
-                return &p->profile.rp_config.profile;
-            }
+// Flat per-appid policy: one block for every Android user that has
+// profiles, and a shared block for all other users. Only app and system
+// appids are covered, anything above (isolated uids) is computed on demand.
+#define UID_POLICY_APPIDS (LAST_APPLICATION_UID + 1)
+#define UID_POLICY_MAX_USERS 8
+#define UID_POLICY_MAX_MANAGERS 16
+
+struct uid_policy_table {
+    struct rcu_head rcu;
+    bool partial; // users without a block may not use the shared one
+    int nr_users;
+    u32 userids[UID_POLICY_MAX_USERS];
+    u8 base[UID_POLICY_APPIDS];
+    u8 users[][UID_POLICY_APPIDS];
+};
+
+static struct uid_policy_table __rcu *uid_policy;
+
+static void free_uid_policy_rcu(struct rcu_head *rcu)
+{
+    vfree(container_of(rcu, struct uid_policy_table, rcu));
+}
+
+static int uid_policy_user_index(u32 *userids, int nr_users, u32 userid)
+{
+    int i;
+
+    for (i = 0; i < nr_users; i++) {
+        if (userids[i] == userid)
+            return i;
+    }
+
+    return -1;
+}
+
+static struct uid_policy_table *compile_uid_policy(void)
+{
+    u16 managers[UID_POLICY_MAX_MANAGERS];
+    u32 userids[UID_POLICY_MAX_USERS];
+    struct uid_policy_table *table;
+    struct perm_data *p;
+    bool partial = false;
+    int nr_managers, nr_users = 0;
+    int i;
+    u32 appid;
+
+    nr_managers = ksu_get_manager_appids(managers, ARRAY_SIZE(managers));
+    if (nr_managers > (int)ARRAY_SIZE(managers)) {
+        pr_warn("too many managers, uid policy table disabled\n");
+        return NULL;
+    }
+
+    // user 0 always gets its own block, system uids are forbidden only there
+    userids[nr_users++] = 0;
+    list_for_each_entry (p, &allow_list, list) {
+        u32 userid = p->uid / PER_USER_RANGE;
+
+        if (uid_policy_user_index(userids, nr_users, userid) >= 0)
+            continue;
+        if (nr_users == UID_POLICY_MAX_USERS) {
+            partial = true;
+            continue;
         }
+        userids[nr_users++] = userid;
     }
 
+    table = vzalloc(sizeof(*table) + nr_users * UID_POLICY_APPIDS);
+    if (!table) {
+        pr_err("uid policy table alloc failed\n");
+        return NULL;
+    }
+
+    table->partial = partial;
+    table->nr_users = nr_users;
+    memcpy(table->userids, userids, nr_users * sizeof(u32));
+
+    memset(table->base,
+           KSU_UID_POLICY_DEFAULT | (default_non_root_profile.umount_modules ?
+                                         KSU_UID_POLICY_UMOUNT :
+                                         0),
+           sizeof(table->base));
+    for (i = 0; i < nr_managers; i++) {
+        if (managers[i] < UID_POLICY_APPIDS)
+            table->base[managers[i]] = KSU_UID_POLICY_MANAGER |
+                                       KSU_UID_POLICY_ALLOW_SU |
+                                       KSU_UID_POLICY_DEFAULT;
+    }
+
+    for (i = 0; i < nr_users; i++)
+        memcpy(table->users[i], table->base, sizeof(table->base));
+    for (appid = 0; appid < SHELL_UID; appid++) {
+        if (forbid_system_uid(appid))
+            table->users[0][appid] &= ~KSU_UID_POLICY_ALLOW_SU;
+    }
+
+    list_for_each_entry (p, &allow_list, list) {
+        uid_t uid = p->uid;
+
+        i = uid_policy_user_index(userids, nr_users, uid / PER_USER_RANGE);
+        if (i < 0 || uid % PER_USER_RANGE >= UID_POLICY_APPIDS)
+            continue;
+        table->users[i][uid % PER_USER_RANGE] = compute_uid_policy(uid);
+    }
+
+    return table;
+}
+
+static void refresh_uid_policy_locked(void)
+{
+    struct uid_policy_table *table, *old;
+
+    // on failure lookups fall back to the lists, never to a stale table
+    table = compile_uid_policy();
+    old = rcu_dereference_protected(uid_policy,
+                                    lockdep_is_held(&allowlist_mutex));
+    rcu_assign_pointer(uid_policy, table);
+
+    if (old)
+        call_rcu(&old->rcu, free_uid_policy_rcu);
+}
+
+void ksu_refresh_uid_policy(void)
+{
+    mutex_lock(&allowlist_mutex);
+    refresh_uid_policy_locked();
+    mutex_unlock(&allowlist_mutex);
+}
+
+u8 ksu_get_uid_policy(uid_t uid)
+{
+    struct uid_policy_table *table;
+    u32 appid = uid % PER_USER_RANGE;
+    int policy = -1;
+    int i;
+
+    if (likely(appid < UID_POLICY_APPIDS)) {
+        rcu_read_lock();
+        table = rcu_dereference(uid_policy);
+        if (likely(table)) {
+            i = uid_policy_user_index(table->userids, table->nr_users,
+                                      uid / PER_USER_RANGE);
+            if (i >= 0)
+                policy = table->users[i][appid];
+            else if (!table->partial)
+                policy = table->base[appid];
+        }
+        rcu_read_unlock();
+    }
+
+    if (likely(policy >= 0))
+        return policy;
+
+    return compute_uid_policy(uid);
+}
+
+bool __ksu_is_allow_uid(uid_t uid)
+{
+    return ksu_get_uid_policy(uid) & KSU_UID_POLICY_ALLOW_SU;
+}
+
+bool ksu_uid_should_umount(uid_t uid)
+{
+    return ksu_get_uid_policy(uid) & KSU_UID_POLICY_UMOUNT;
+}
+
+bool __ksu_is_allow_uid_for_current(uid_t uid)
+{
+    if (unlikely(uid == 0)) {
+        // already root, but only allow our domain.
+        return is_ksu_domain();
+    }
+    return __ksu_is_allow_uid(uid);
+}
+
+void ksu_get_root_profile(uid_t uid, struct root_profile *profile)
+{
+    struct shared_root_profile *root;
+
+    rcu_read_lock();
+    root = find_root_profile(uid);
     // use default profile
-    return &default_root_profile;
+    memcpy(profile, root ? &root->profile : &default_root_profile,
+           sizeof(*profile));
+    rcu_read_unlock();
 }
 
 bool ksu_get_allow_list(int *array, int *length, bool allow)
@@ -365,13 +949,15 @@ bool ksu_get_allow_list(int *array, int *length, bool allow)
     struct perm_data *p = NULL;
     struct list_head *pos = NULL;
     int i = 0;
-    list_for_each (pos, &allow_list) {
+    rcu_read_lock();
+    list_for_each_rcu (pos, &allow_list) {
         p = list_entry(pos, struct perm_data, list);
         // pr_info("get_allow_list uid: %d allow: %d\n", p->uid, p->allow);
-        if (p->profile.allow_su == allow) {
-            array[i++] = p->profile.current_uid;
+        if (p->allow_su == allow) {
+            array[i++] = p->uid;
         }
     }
+    rcu_read_unlock();
     *length = i;
 
     return true;
@@ -383,9 +969,18 @@ static void do_persistent_allow_list(struct callback_head *_cb)
     u32 version = FILE_FORMAT_VERSION;
     struct perm_data *p = NULL;
     struct list_head *pos = NULL;
+    struct app_profile *profile;
     struct file *fp = NULL;
     loff_t off = 0;
 
+    // entries are stored compact, the file keeps the full profile format
+    profile = kmalloc(sizeof(*profile), GFP_KERNEL);
+    if (!profile) {
+        pr_err("save_allow_list alloc failed\n");
+        kfree(_cb);
+        return;
+    }
+
     mutex_lock(&allowlist_mutex);
     fp = ksu_filp_open_compat(KERNEL_SU_ALLOWLIST, O_WRONLY | O_CREAT | O_TRUNC,
                               0644);
@@ -409,16 +1004,18 @@ static void do_persistent_allow_list(struct callback_head *_cb)
 
     list_for_each (pos, &allow_list) {
         p = list_entry(pos, struct perm_data, list);
-        pr_info("save allow list, name: %s uid :%d, allow: %d\n",
-                p->profile.key, p->profile.current_uid, p->profile.allow_su);
+        pr_info("save allow list, name: %s uid :%d, allow: %d\n", p->key,
+                p->uid, p->allow_su);
 
-        ksu_kernel_write_compat(fp, &p->profile, sizeof(p->profile), &off);
+        expand_perm_data(p, profile);
+        ksu_kernel_write_compat(fp, profile, sizeof(*profile), &off);
     }
 
 close_file:
     filp_close(fp, 0);
 unlock:
     mutex_unlock(&allowlist_mutex);
+    kfree(profile);
     kfree(_cb);
 }
 
@@ -513,31 +1110,34 @@ void ksu_prune_allowlist(bool (*is_uid_valid)(uid_t, char *, void *),
         return;
     }
 
-    // TODO: use RCU!
     mutex_lock(&allowlist_mutex);
     list_for_each_entry_safe (np, n, &allow_list, list) {
-        uid_t uid = np->profile.current_uid;
-        char *package = np->profile.key;
+        uid_t uid = np->uid;
+        char *package = (char *)np->key;
         // we use this uid for special cases, don't prune it!
         bool is_preserved_uid = uid == KSU_APP_PROFILE_PRESERVE_UID;
         if (!is_preserved_uid && !is_uid_valid(uid, package, data)) {
             modified = true;
             pr_info("prune uid: %d, package: %s\n", uid, package);
-            list_del(&np->list);
+            trace_ksu_allowlist_change(KSU_ALLOWLIST_PRUNE, package, uid,
+                                       np->allow_su);
+            list_del_rcu(&np->list);
             if (likely(uid <= BITMAP_UID_MAX)) {
                 allow_list_bitmap[uid / BITS_PER_BYTE] &=
                     ~(1 << (uid % BITS_PER_BYTE));
             }
             remove_uid_from_arr(uid);
             smp_mb();
-            kfree(np);
+            call_rcu(&np->rcu, free_perm_data_rcu);
+            refresh_root_template(uid);
         }
     }
+    if (modified)
+        refresh_uid_policy_locked();
     mutex_unlock(&allowlist_mutex);
 
-    if (modified) {
+    if (modified)
         persistent_allow_list();
-    }
 }
 
 void ksu_allowlist_init(void)
@@ -553,18 +1153,46 @@ void ksu_allowlist_init(void)
     INIT_LIST_HEAD(&allow_list);
 
     init_default_profiles();
+    refresh_default_root_template();
+    ksu_refresh_uid_policy();
 }
 
 void ksu_allowlist_exit(void)
 {
     struct perm_data *np = NULL;
     struct perm_data *n = NULL;
+    struct root_tmpl_node *node;
+    struct root_cred_template *tmpl;
+    struct uid_policy_table *table;
+    struct hlist_node *tmp;
+    int bkt;
 
     // free allowlist
     mutex_lock(&allowlist_mutex);
     list_for_each_entry_safe (np, n, &allow_list, list) {
         list_del(&np->list);
+        release_perm_data(np);
         kfree(np);
     }
+    table = rcu_dereference_protected(uid_policy,
+                                      lockdep_is_held(&allowlist_mutex));
+    RCU_INIT_POINTER(uid_policy, NULL);
     mutex_unlock(&allowlist_mutex);
+    if (table)
+        call_rcu(&table->rcu, free_uid_policy_rcu);
+
+    spin_lock(&root_tmpl_lock);
+    hash_for_each_safe (root_tmpl_table, bkt, tmp, node, hash) {
+        hash_del_rcu(&node->hash);
+        call_rcu(&node->rcu, free_root_tmpl_node_rcu);
+    }
+    tmpl = rcu_dereference_protected(default_root_tmpl,
+                                     lockdep_is_held(&root_tmpl_lock));
+    RCU_INIT_POINTER(default_root_tmpl, NULL);
+    spin_unlock(&root_tmpl_lock);
+
+    ksu_put_root_cred_template(tmpl);
+    // the node callbacks drop templates, which queue callbacks of their own
+    rcu_barrier();
+    rcu_barrier();
 }
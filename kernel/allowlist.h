@@ -37,7 +37,22 @@ bool ksu_get_app_profile(struct app_profile *);
 bool ksu_set_app_profile(struct app_profile *, bool persist);
 
 bool ksu_uid_should_umount(uid_t uid);
-struct root_profile *ksu_get_root_profile(uid_t uid);
+
+// Compiled per-uid policy bits, see ksu_get_uid_policy
+#define KSU_UID_POLICY_MANAGER (1 << 0)
+#define KSU_UID_POLICY_ALLOW_SU (1 << 1)
+#define KSU_UID_POLICY_UMOUNT (1 << 2)
+#define KSU_UID_POLICY_DEFAULT (1 << 3) // no profile of its own
+
+// Policy of an uid, a single table load for app uids
+u8 ksu_get_uid_policy(uid_t uid);
+// Recompile the policy table, must follow every profile or manager change
+void ksu_refresh_uid_policy(void);
+
+// Copy of the root profile an uid escalates with
+void ksu_get_root_profile(uid_t uid, struct root_profile *profile);
+// Returns a referenced template, release with ksu_put_root_cred_template
+struct root_cred_template *ksu_get_root_cred_template(uid_t uid);
 
 static inline bool is_appuid(uid_t uid)
 {
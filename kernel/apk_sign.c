@@ -2,7 +2,10 @@
 #include <linux/fs.h>
 #include <linux/gfp.h>
 #include <linux/kernel.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/version.h>
 #ifdef CONFIG_KSU_DEBUG
 #include <linux/moduleparam.h>
@@ -13,6 +16,11 @@
 #else
 #include <crypto/sha.h>
 #endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 5, 0)
+#include <crypto/utils.h>
+#else
+#include <crypto/algapi.h>
+#endif
 
 #include "apk_sign.h"
 #include "dynamic_manager.h"
@@ -46,6 +54,143 @@ static apk_sign_key_t apk_sign_keys[] = {
 #endif
 };
 
+/*
+ * Every key the manager apk may be signed with, as raw digests sorted by
+ * (size, digest, index). A certificate is matched by finding its size
+ * bucket with a binary search and comparing the digests inside it. The
+ * static keys are decoded once at init; the table is rebuilt whenever the
+ * dynamic manager keys change.
+ */
+struct sign_key_table {
+    struct rcu_head rcu;
+    int count;
+    struct ksu_sign_digest keys[];
+};
+
+static struct sign_key_table __rcu *sign_keys;
+static DEFINE_MUTEX(sign_keys_mutex);
+
+static struct ksu_sign_digest static_sign_keys[ARRAY_SIZE(apk_sign_keys)];
+static int nr_static_sign_keys;
+
+static int cmp_sign_digest(const void *a, const void *b)
+{
+    const struct ksu_sign_digest *x = a, *y = b;
+    int ret;
+
+    if (x->size != y->size)
+        return x->size < y->size ? -1 : 1;
+    ret = memcmp(x->digest, y->digest, KSU_SIGN_DIGEST_SIZE);
+    if (ret)
+        return ret;
+    // a dynamic key equal to a built-in one matches as the built-in one
+    return (int)x->index - (int)y->index;
+}
+
+int ksu_set_dynamic_sign_keys(const struct ksu_sign_digest *keys, int count)
+{
+    struct sign_key_table *table, *old;
+    int total = nr_static_sign_keys + count;
+
+    table = kmalloc(sizeof(*table) + total * sizeof(table->keys[0]),
+                    GFP_KERNEL);
+    if (!table)
+        return -ENOMEM;
+
+    table->count = total;
+    memcpy(table->keys, static_sign_keys,
+           nr_static_sign_keys * sizeof(table->keys[0]));
+    if (count)
+        memcpy(table->keys + nr_static_sign_keys, keys,
+               count * sizeof(table->keys[0]));
+    sort(table->keys, total, sizeof(table->keys[0]), cmp_sign_digest, NULL);
+
+    mutex_lock(&sign_keys_mutex);
+    old = rcu_dereference_protected(sign_keys,
+                                    lockdep_is_held(&sign_keys_mutex));
+    rcu_assign_pointer(sign_keys, table);
+    mutex_unlock(&sign_keys_mutex);
+
+    if (old)
+        kfree_rcu(old, rcu);
+    return 0;
+}
+
+static bool match_sign_key(u32 size, const u8 *digest, u8 *matched_index)
+{
+    struct sign_key_table *table;
+    bool matched = false;
+    int lo, hi, mid;
+
+    rcu_read_lock();
+    table = rcu_dereference(sign_keys);
+    if (!table)
+        goto out;
+
+    // first key of the size bucket
+    lo = 0;
+    hi = table->count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (table->keys[mid].size < size)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (; lo < table->count && table->keys[lo].size == size; lo++) {
+        if (crypto_memneq(table->keys[lo].digest, digest,
+                          KSU_SIGN_DIGEST_SIZE))
+            continue;
+        if (matched_index)
+            *matched_index = table->keys[lo].index;
+        matched = true;
+        break;
+    }
+out:
+    rcu_read_unlock();
+    return matched;
+}
+
+void ksu_apk_sign_init(void)
+{
+    struct ksu_sign_digest *key;
+    int i;
+
+    // keep 255, because i want use 255 as the magic number of dynamic manager
+    BUILD_BUG_ON(ARRAY_SIZE(apk_sign_keys) >= 255);
+    BUILD_BUG_ON(KSU_SIGN_DIGEST_SIZE != SHA256_DIGEST_SIZE);
+
+    for (i = 0; i < (int)ARRAY_SIZE(apk_sign_keys); i++) {
+        key = &static_sign_keys[nr_static_sign_keys];
+        if (hex2bin(key->digest, apk_sign_keys[i].sha256,
+                    KSU_SIGN_DIGEST_SIZE)) {
+            pr_err("invalid sign key hash at index %d\n", i);
+            continue;
+        }
+        key->size = apk_sign_keys[i].size;
+        key->index = i;
+        nr_static_sign_keys++;
+    }
+
+    if (ksu_set_dynamic_sign_keys(NULL, 0))
+        pr_err("failed to build sign key table\n");
+}
+
+void ksu_apk_sign_exit(void)
+{
+    struct sign_key_table *table;
+
+    mutex_lock(&sign_keys_mutex);
+    table = rcu_dereference_protected(sign_keys,
+                                      lockdep_is_held(&sign_keys_mutex));
+    RCU_INIT_POINTER(sign_keys, NULL);
+    mutex_unlock(&sign_keys_mutex);
+
+    synchronize_rcu();
+    kfree(table);
+}
+
 static struct sdesc *init_sdesc(struct crypto_shash *alg)
 {
     struct sdesc *sdesc;
@@ -96,11 +241,8 @@ static int ksu_sha256(const unsigned char *data, unsigned int datalen,
 static bool check_block(struct file *fp, u32 *size4, loff_t *pos, u32 *offset,
                         u8 *matched_index)
 {
-    u8 i;
-    apk_sign_key_t sign_key;
-    bool signature_valid = false;
+    bool signature_valid;
     unsigned char digest[SHA256_DIGEST_SIZE];
-    char hash_str[SHA256_DIGEST_SIZE * 2 + 1];
 #define CERT_MAX_LENGTH 1024
     char cert[CERT_MAX_LENGTH];
 
@@ -129,30 +271,7 @@ static bool check_block(struct file *fp, u32 *size4, loff_t *pos, u32 *offset,
         pr_err("sha256 error\n");
         return false;
     }
-    bin2hex(hash_str, digest, SHA256_DIGEST_SIZE);
-    hash_str[SHA256_DIGEST_SIZE * 2] = '\0';
-
-    BUILD_BUG_ON(
-        ARRAY_SIZE(apk_sign_keys) >=
-        255); // keep 255, because i want use 255 as the magic number of dynamic manager
-    for (i = 0; i < ARRAY_SIZE(apk_sign_keys); i++) {
-        sign_key = apk_sign_keys[i];
-        if (*size4 == sign_key.size && strcmp(sign_key.sha256, hash_str) == 0) {
-            if (matched_index)
-                *matched_index = i;
-            signature_valid = true;
-            break;
-        }
-    }
-
-    if (!signature_valid && ksu_is_dynamic_manager_enabled()) {
-        sign_key = ksu_get_dynamic_manager_sign();
-        if (*size4 == sign_key.size && strcmp(sign_key.sha256, hash_str) == 0) {
-            if (matched_index)
-                *matched_index = DYNAMIC_MANAGER_SIGNATURE_INDEX_MAGIC;
-            signature_valid = true;
-        }
-    }
+    signature_valid = match_sign_key(*size4, digest, matched_index);
 
     *offset += *size4;
 
@@ -3,10 +3,16 @@
 
 #include <linux/types.h>
 #include "ksu.h"
+#include "manager_sign.h"
 
 bool is_manager_apk(char *path, u8 *signature_index);
 int get_pkg_from_apk_path(char *pkg, const char *path);
 
+void ksu_apk_sign_init(void);
+void ksu_apk_sign_exit(void);
+// replace the dynamic manager keys, the built-in keys always stay
+int ksu_set_dynamic_sign_keys(const struct ksu_sign_digest *keys, int count);
+
 bool is_dynamic_manager_apk(char *path, int *signature_index);
 
 #endif
\ No newline at end of file
@@ -7,12 +7,14 @@
 #include <linux/fs.h>
 #include <linux/proc_ns.h>
 #include <linux/pid.h>
+#include <linux/rcupdate.h>
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
 #include <linux/sched/signal.h> // signal_struct
 #include <linux/sched/task.h>
 #endif
 #include <linux/sched.h>
 #include <linux/seccomp.h>
+#include <linux/slab.h>
 #include <linux/thread_info.h>
 #include <linux/uidgid.h>
 #include <linux/syscalls.h>
@@ -25,7 +27,9 @@
 #include "app_profile.h"
 #include "arch.h"
 #include "kernel_compat.h"
+#include "hook_stats.h"
 #include "klog.h" // IWYU pragma: keep
+#include "ksu_trace.h"
 #include "selinux/selinux.h"
 #include "su_mount_ns.h"
 #ifdef KSU_TP_HOOK
@@ -39,26 +43,25 @@ static struct group_info root_groups = { .usage = REFCOUNT_INIT(2) };
 static struct group_info root_groups = { .usage = ATOMIC_INIT(2) };
 #endif
 
-static void setup_groups(struct root_profile *profile, struct cred *cred)
+// Build the sorted group list of a profile. Returns NULL if the groups of the
+// escalated process should be left untouched.
+static struct group_info *compile_groups(const struct root_profile *profile)
 {
     if (profile->groups_count > KSU_MAX_GROUPS) {
         pr_warn("Failed to setgroups, too large group: %d!\n", profile->uid);
-        return;
+        return NULL;
     }
 
     if (profile->groups_count == 1 && profile->groups[0] == 0) {
         // setgroup to root and return early.
-        if (cred->group_info)
-            put_group_info(cred->group_info);
-        cred->group_info = get_group_info(&root_groups);
-        return;
+        return get_group_info(&root_groups);
     }
 
     u32 ngroups = profile->groups_count;
     struct group_info *group_info = groups_alloc(ngroups);
     if (!group_info) {
         pr_warn("Failed to setgroups, ENOMEM for: %d\n", profile->uid);
-        return;
+        return NULL;
     }
 
     int i;
@@ -68,7 +71,7 @@ static void setup_groups(struct root_profile *profile, struct cred *cred)
         if (!gid_valid(kgid)) {
             pr_warn("Failed to setgroups, invalid gid: %d\n", gid);
             put_group_info(group_info);
-            return;
+            return NULL;
         }
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 9, 0)
         group_info->gid[i] = kgid;
@@ -78,8 +81,116 @@ static void setup_groups(struct root_profile *profile, struct cred *cred)
     }
 
     groups_sort(group_info);
-    set_groups(cred, group_info);
-    put_group_info(group_info);
+    return group_info;
+}
+
+struct root_cred_template {
+    atomic_t usage;
+
+    uid_t uid;
+    gid_t gid;
+    kernel_cap_t cap_effective;
+    kernel_cap_t cap_permitted;
+    struct group_info *group_info; // NULL: keep the groups of the caller
+
+    // resolved lazily, the domain may not exist until policy is patched
+    u32 sid;
+    char selinux_domain[KSU_SELINUX_DOMAIN];
+
+    int32_t namespaces;
+
+    struct rcu_head rcu;
+};
+
+struct root_cred_template *
+ksu_compile_root_profile(const struct root_profile *profile)
+{
+    struct root_cred_template *tmpl;
+
+    tmpl = kzalloc(sizeof(*tmpl), GFP_KERNEL);
+    if (!tmpl) {
+        pr_err("compile root profile: alloc failed\n");
+        return NULL;
+    }
+
+    atomic_set(&tmpl->usage, 1);
+    tmpl->uid = profile->uid;
+    tmpl->gid = profile->gid;
+
+    BUILD_BUG_ON(sizeof(profile->capabilities.effective) !=
+                 sizeof(kernel_cap_t));
+
+    // we need CAP_DAC_READ_SEARCH becuase `/data/adb/ksud` is not accessible for non root process
+    // we add it here but don't add it to cap_inhertiable, it would be dropped automaticly after exec!
+    u64 cap_for_ksud = profile->capabilities.effective | CAP_DAC_READ_SEARCH;
+    memcpy(&tmpl->cap_effective, &cap_for_ksud, sizeof(tmpl->cap_effective));
+    memcpy(&tmpl->cap_permitted, &profile->capabilities.effective,
+           sizeof(tmpl->cap_permitted));
+
+    tmpl->group_info = compile_groups(profile);
+
+    memcpy(tmpl->selinux_domain, profile->selinux_domain,
+           sizeof(tmpl->selinux_domain));
+    tmpl->selinux_domain[sizeof(tmpl->selinux_domain) - 1] = '\0';
+
+    tmpl->namespaces = profile->namespaces;
+
+    return tmpl;
+}
+
+bool ksu_tryget_root_cred_template(struct root_cred_template *tmpl)
+{
+    return atomic_inc_not_zero(&tmpl->usage);
+}
+
+static void free_root_cred_template_rcu(struct rcu_head *rcu)
+{
+    struct root_cred_template *tmpl =
+        container_of(rcu, struct root_cred_template, rcu);
+
+    if (tmpl->group_info)
+        put_group_info(tmpl->group_info);
+    kfree(tmpl);
+}
+
+void ksu_put_root_cred_template(struct root_cred_template *tmpl)
+{
+    if (tmpl && atomic_dec_and_test(&tmpl->usage))
+        call_rcu(&tmpl->rcu, free_root_cred_template_rcu);
+}
+
+static void apply_root_cred_template(struct root_cred_template *tmpl,
+                                     struct cred *cred)
+{
+    u32 sid;
+
+    cred->uid.val = tmpl->uid;
+    cred->suid.val = tmpl->uid;
+    cred->euid.val = tmpl->uid;
+    cred->fsuid.val = tmpl->uid;
+
+    cred->gid.val = tmpl->gid;
+    cred->fsgid.val = tmpl->gid;
+    cred->sgid.val = tmpl->gid;
+    cred->egid.val = tmpl->gid;
+    cred->securebits = 0;
+
+    cred->cap_effective = tmpl->cap_effective;
+    cred->cap_permitted = tmpl->cap_permitted;
+    cred->cap_bset = tmpl->cap_permitted;
+
+    if (tmpl->group_info)
+        set_groups(cred, tmpl->group_info);
+
+    sid = READ_ONCE(tmpl->sid);
+    if (unlikely(!sid)) {
+        if (ksu_domain_to_sid(tmpl->selinux_domain, &sid)) {
+            pr_err("transive domain failed.\n");
+            return;
+        }
+        WRITE_ONCE(tmpl->sid, sid);
+    }
+    setup_selinux_sid(sid, cred);
 }
 
 void disable_seccomp(struct task_struct *tsk)
@@ -124,11 +235,14 @@ void disable_seccomp(struct task_struct *tsk)
 #endif
 }
 
-void escape_with_root_profile(void)
+static void __escape_with_root_profile(void)
 {
     struct cred *cred;
+    struct root_cred_template *tmpl;
+    int32_t namespaces;
     // a bit useless, but we just want less ifdefs
     struct task_struct *p = current;
+    uid_t uid = current_uid().val;
 
     if (current_euid().val == 0) {
         pr_warn("Already root, don't escape!\n");
@@ -141,36 +255,28 @@ void escape_with_root_profile(void)
         return;
     }
 
-    struct root_profile *profile = ksu_get_root_profile(cred->uid.val);
+    tmpl = ksu_get_root_cred_template(cred->uid.val);
+    if (unlikely(!tmpl)) {
+        // the cached template is missing (ENOMEM when profile was set), build it now
+        struct root_profile *profile = kmalloc(sizeof(*profile), GFP_KERNEL);
 
-    cred->uid.val = profile->uid;
-    cred->suid.val = profile->uid;
-    cred->euid.val = profile->uid;
-    cred->fsuid.val = profile->uid;
-
-    cred->gid.val = profile->gid;
-    cred->fsgid.val = profile->gid;
-    cred->sgid.val = profile->gid;
-    cred->egid.val = profile->gid;
-    cred->securebits = 0;
-
-    BUILD_BUG_ON(sizeof(profile->capabilities.effective) !=
-                 sizeof(kernel_cap_t));
-
-    // setup capabilities
-    // we need CAP_DAC_READ_SEARCH becuase `/data/adb/ksud` is not accessible for non root process
-    // we add it here but don't add it to cap_inhertiable, it would be dropped automaticly after exec!
-    u64 cap_for_ksud = profile->capabilities.effective | CAP_DAC_READ_SEARCH;
-    memcpy(&cred->cap_effective, &cap_for_ksud, sizeof(cred->cap_effective));
-    memcpy(&cred->cap_permitted, &profile->capabilities.effective,
-           sizeof(cred->cap_permitted));
-    memcpy(&cred->cap_bset, &profile->capabilities.effective,
-           sizeof(cred->cap_bset));
+        if (profile) {
+            ksu_get_root_profile(cred->uid.val, profile);
+            tmpl = ksu_compile_root_profile(profile);
+            kfree(profile);
+        }
+        if (!tmpl) {
+            abort_creds(cred);
+            return;
+        }
+    }
 
-    setup_groups(profile, cred);
-    setup_selinux(profile->selinux_domain, cred);
+    apply_root_cred_template(tmpl, cred);
+    namespaces = tmpl->namespaces;
+    ksu_put_root_cred_template(tmpl);
 
     commit_creds(cred);
+    trace_ksu_su_grant(uid, cred->uid.val, cred->gid.val);
 
     // Refer to kernel/seccomp.c: seccomp_set_mode_strict
     // When disabling Seccomp, ensure that current->sighand->siglock is held during the operation.
@@ -188,7 +294,15 @@ void escape_with_root_profile(void)
         ksu_set_task_tracepoint_flag(t);
     }
 #endif
-    setup_mount_ns(profile->namespaces);
+    setup_mount_ns(namespaces);
+}
+
+void escape_with_root_profile(void)
+{
+    u64 start = ksu_hook_stats_start();
+
+    __escape_with_root_profile();
+    ksu_hook_stats_end(KSU_HOOK_ESCAPE_ROOT, start);
 }
 
 void escape_to_root_for_init(void)
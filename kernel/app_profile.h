@@ -60,6 +60,16 @@ struct app_profile {
     };
 };
 
+// A root profile compiled into ready-to-commit cred fields: uid/gid, the
+// capability sets, a sorted group_info and the SELinux sid. Compiled once
+// when a profile is set, shared by every escalation through a refcount.
+struct root_cred_template;
+
+struct root_cred_template *
+ksu_compile_root_profile(const struct root_profile *profile);
+bool ksu_tryget_root_cred_template(struct root_cred_template *tmpl);
+void ksu_put_root_cred_template(struct root_cred_template *tmpl);
+
 // Escalate current process to root with the appropriate profile
 void escape_with_root_profile(void);
 void escape_to_root_for_cmd_su(uid_t target_uid, pid_t target_pid);
@@ -2,6 +2,7 @@
 #include <linux/fs.h>
 #include <linux/gfp.h>
 #include <linux/kernel.h>
+#include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/version.h>
 #include <linux/workqueue.h>
@@ -21,6 +22,7 @@
 #include <crypto/sha.h>
 #endif
 
+#include "apk_sign.h"
 #include "throne_tracker.h"
 #include "kernel_compat.h"
 #include "dynamic_manager.h"
@@ -29,30 +31,106 @@
 #include "ksu.h"
 
 // Dynamic sign configuration
-static struct dynamic_manager_config dynamic_manager = {
-    .size = 0x300,
-    .hash = "0000000000000000000000000000000000000000000000000000000000000000",
-    .is_set = 0
-};
+static struct dynamic_manager_config dynamic_manager;
+static DEFINE_MUTEX(dynamic_manager_mutex);
 
-bool ksu_is_dynamic_manager_enabled(void)
+static int find_dynamic_key(const struct ksu_sign_digest *key)
 {
-    return dynamic_manager.is_set;
+    int i;
+
+    for (i = 0; i < dynamic_manager.nr_keys; i++) {
+        if (dynamic_manager.keys[i].size == key->size &&
+            !memcmp(dynamic_manager.keys[i].digest, key->digest,
+                    KSU_SIGN_DIGEST_SIZE))
+            return i;
+    }
+    return -1;
+}
+
+// publish keys to the signature table, the config follows only on success
+static int commit_dynamic_keys(const struct ksu_sign_digest *keys,
+                               int nr_keys)
+{
+    int ret = ksu_set_dynamic_sign_keys(keys, nr_keys);
+
+    if (ret)
+        return ret;
+
+    if (nr_keys)
+        memcpy(dynamic_manager.keys, keys, nr_keys * sizeof(keys[0]));
+    dynamic_manager.nr_keys = nr_keys;
+    return 0;
+}
+
+static int add_dynamic_key(const struct ksu_sign_digest *key, bool *evicted)
+{
+    struct ksu_sign_digest keys[DYNAMIC_MANAGER_MAX_KEYS];
+    int nr_keys = dynamic_manager.nr_keys;
+
+    *evicted = false;
+    if (find_dynamic_key(key) >= 0)
+        return 0;
+
+    memcpy(keys, dynamic_manager.keys, sizeof(keys));
+    if (nr_keys == DYNAMIC_MANAGER_MAX_KEYS) {
+        // drop the oldest key to make room
+        memmove(keys, keys + 1, (nr_keys - 1) * sizeof(keys[0]));
+        nr_keys--;
+        *evicted = true;
+    }
+    keys[nr_keys++] = *key;
+
+    return commit_dynamic_keys(keys, nr_keys);
+}
+
+static int remove_dynamic_key(const struct ksu_sign_digest *key)
+{
+    struct ksu_sign_digest keys[DYNAMIC_MANAGER_MAX_KEYS];
+    int nr_keys = dynamic_manager.nr_keys;
+    int i = find_dynamic_key(key);
+
+    if (i < 0)
+        return -ENOENT;
+
+    memcpy(keys, dynamic_manager.keys, sizeof(keys));
+    memmove(keys + i, keys + i + 1, (nr_keys - i - 1) * sizeof(keys[0]));
+
+    return commit_dynamic_keys(keys, nr_keys - 1);
 }
 
-apk_sign_key_t ksu_get_dynamic_manager_sign(void)
+static int parse_dynamic_key(const struct ksu_dynamic_manager_cmd *cmd,
+                             struct ksu_sign_digest *key)
 {
-    apk_sign_key_t sign_key = { .size = dynamic_manager.size,
-                                .sha256 = dynamic_manager.hash };
+    int i;
+
+    if (cmd->size < 0x100 || cmd->size > 0x1000) {
+        pr_err("invalid size: 0x%x\n", cmd->size);
+        return -EINVAL;
+    }
+
+    // Validate hash format
+    for (i = 0; i < 64; i++) {
+        char c = cmd->hash[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            pr_err("invalid hash character at position %d: %c\n", i, c);
+            return -EINVAL;
+        }
+    }
 
-    return sign_key;
+    key->size = cmd->size;
+    key->index = DYNAMIC_MANAGER_SIGNATURE_INDEX_MAGIC;
+    // userspace always put an char[64] to our, without the trailing \0
+    if (hex2bin(key->digest, cmd->hash, KSU_SIGN_DIGEST_SIZE))
+        return -EINVAL;
+
+    return 0;
 }
 
 int ksu_handle_dynamic_manager(struct ksu_dynamic_manager_cmd *cmd)
 {
-    unsigned long flags;
+    struct ksu_sign_digest key;
+    bool key_dropped = false;
     int ret = 0;
-    int i;
 
     if (!cmd) {
         return -EINVAL;
@@ -60,52 +138,61 @@ int ksu_handle_dynamic_manager(struct ksu_dynamic_manager_cmd *cmd)
 
     switch (cmd->operation) {
     case DYNAMIC_MANAGER_OP_SET:
-        if (cmd->size < 0x100 || cmd->size > 0x1000) {
-            pr_err("invalid size: 0x%x\n", cmd->size);
-            return -EINVAL;
-        }
-
-        // Validate hash format
-        for (i = 0; i < 64; i++) {
-            char c = cmd->hash[i];
-            if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
-                pr_err("invalid hash character at position %d: %c\n", i, c);
-                return -EINVAL;
-            }
+    case DYNAMIC_MANAGER_OP_ADD:
+    case DYNAMIC_MANAGER_OP_REMOVE:
+        ret = parse_dynamic_key(cmd, &key);
+        if (ret)
+            return ret;
+
+        mutex_lock(&dynamic_manager_mutex);
+        if (cmd->operation == DYNAMIC_MANAGER_OP_SET) {
+            // replaces every key set before
+            key_dropped = dynamic_manager.nr_keys > 0;
+            ret = commit_dynamic_keys(&key, 1);
+        } else if (cmd->operation == DYNAMIC_MANAGER_OP_ADD) {
+            ret = add_dynamic_key(&key, &key_dropped);
+        } else {
+            ret = remove_dynamic_key(&key);
+            key_dropped = true;
         }
+        mutex_unlock(&dynamic_manager_mutex);
+        if (ret)
+            return ret;
 
-        if (dynamic_manager.is_set) {
+        // every dynamic manager goes, the rescan brings back those whose
+        // key is still set
+        if (key_dropped) {
             ksu_unregister_manager_by_signature_index(
                 DYNAMIC_MANAGER_SIGNATURE_INDEX_MAGIC);
         }
 
-        dynamic_manager.size = cmd->size;
-        // userspace always put an char[64] to our
-        // we just use memcpy to copy memory, and flag [64] to \0 by ourselves
-        memcpy(dynamic_manager.hash, cmd->hash, 64);
-        dynamic_manager.hash[64] = '\0';
-
-        dynamic_manager.is_set = 1;
-
         track_throne(false, true);
-        pr_info(
-            "dynamic manager updated: size=0x%x, hash=%.16s... (multi-manager enabled)\n",
-            cmd->size, cmd->hash);
+        pr_info("dynamic manager updated: op=%u, size=0x%x, hash=%.16s...\n",
+                cmd->operation, cmd->size, cmd->hash);
         break;
 
     case DYNAMIC_MANAGER_OP_GET:
-        if (dynamic_manager.is_set) {
-            cmd->size = dynamic_manager.size;
-            memcpy(cmd->hash, dynamic_manager.hash,
-                   64); // just copy [64] is enough, userspace will handle that
+        mutex_lock(&dynamic_manager_mutex);
+        if (dynamic_manager.nr_keys) {
+            // the most recently set key
+            const struct ksu_sign_digest *last =
+                &dynamic_manager.keys[dynamic_manager.nr_keys - 1];
+
+            cmd->size = last->size;
+            // just fill [64] is enough, userspace will handle that
+            bin2hex(cmd->hash, last->digest, KSU_SIGN_DIGEST_SIZE);
             ret = 0;
         } else {
             ret = -ENODATA;
         }
+        mutex_unlock(&dynamic_manager_mutex);
         break;
     case DYNAMIC_MANAGER_OP_WIPE:
-        dynamic_manager.is_set = 0;
-        ret = 0;
+        mutex_lock(&dynamic_manager_mutex);
+        ret = commit_dynamic_keys(NULL, 0);
+        mutex_unlock(&dynamic_manager_mutex);
+        if (ret)
+            return ret;
         ksu_unregister_manager_by_signature_index(
             DYNAMIC_MANAGER_SIGNATURE_INDEX_MAGIC);
         pr_info("dynamic manager kernel settings reseted");
@@ -7,11 +7,12 @@
 #include "manager_sign.h"
 
 #define DYNAMIC_MANAGER_SIGNATURE_INDEX_MAGIC 255
+#define DYNAMIC_MANAGER_MAX_KEYS 4
 
 struct dynamic_manager_config {
-    unsigned size;
-    char hash[65];
-    int is_set;
+    int nr_keys;
+    // oldest first, every key uses DYNAMIC_MANAGER_SIGNATURE_INDEX_MAGIC
+    struct ksu_sign_digest keys[DYNAMIC_MANAGER_MAX_KEYS];
 };
 
 struct manager_info {
@@ -25,7 +26,5 @@ void ksu_dynamic_manager_init(void);
 void ksu_dynamic_manager_exit(void);
 int ksu_handle_dynamic_manager(struct ksu_dynamic_manager_cmd *cmd);
 bool ksu_load_dynamic_manager(void);
-bool ksu_is_dynamic_manager_enabled(void);
-apk_sign_key_t ksu_get_dynamic_manager_sign(void);
 
 #endif
\ No newline at end of file
@@ -1,8 +1,15 @@
 #include "feature.h"
 #include "klog.h" // IWYU pragma: keep
+#include "supercalls.h"
 
+#include <linux/compiler.h>
 #include <linux/mutex.h>
 
+/*
+ * Handlers are static and live as long as ksu, so readers only need a
+ * consistent pointer. feature_mutex serializes registration and set
+ * handlers; get never takes it, so the manager can poll freely.
+ */
 static const struct ksu_feature_handler *feature_handlers[KSU_FEATURE_MAX];
 
 static DEFINE_MUTEX(feature_mutex);
@@ -32,7 +39,7 @@ int ksu_register_feature_handler(const struct ksu_feature_handler *handler)
                 handler->feature_id);
     }
 
-    feature_handlers[handler->feature_id] = handler;
+    WRITE_ONCE(feature_handlers[handler->feature_id], handler);
 
     pr_info("feature: registered handler for %s (id=%u)\n",
             handler->name ? handler->name : "unknown", handler->feature_id);
@@ -58,7 +65,7 @@ int ksu_unregister_feature_handler(u32 feature_id)
         goto out;
     }
 
-    feature_handlers[feature_id] = NULL;
+    WRITE_ONCE(feature_handlers[feature_id], NULL);
 
     pr_info("feature: unregistered handler for id=%u\n", feature_id);
 
@@ -82,23 +89,20 @@ int ksu_get_feature(u32 feature_id, u64 *value, bool *supported)
         return -EINVAL;
     }
 
-    mutex_lock(&feature_mutex);
-
-    handler = feature_handlers[feature_id];
+    handler = READ_ONCE(feature_handlers[feature_id]);
 
     if (!handler) {
         *supported = false;
         *value = 0;
         pr_debug("feature: feature %u not supported\n", feature_id);
-        goto out;
+        return 0;
     }
 
     *supported = true;
 
     if (!handler->get_handler) {
         pr_warn("feature: no get_handler for feature %u\n", feature_id);
-        ret = -EOPNOTSUPP;
-        goto out;
+        return -EOPNOTSUPP;
     }
 
     ret = handler->get_handler(value);
@@ -106,14 +110,12 @@ int ksu_get_feature(u32 feature_id, u64 *value, bool *supported)
         pr_err("feature: get_handler for %u failed: %d\n", feature_id, ret);
     }
 
-out:
-    mutex_unlock(&feature_mutex);
     return ret;
 }
 
-int ksu_set_feature(u32 feature_id, u64 value)
+static int __ksu_set_feature(u32 feature_id, u64 value)
 {
-    int ret = 0;
+    int ret;
     const struct ksu_feature_handler *handler;
 
     if (feature_id >= KSU_FEATURE_MAX) {
@@ -121,20 +123,16 @@ int ksu_set_feature(u32 feature_id, u64 value)
         return -EINVAL;
     }
 
-    mutex_lock(&feature_mutex);
-
     handler = feature_handlers[feature_id];
 
     if (!handler) {
         pr_err("feature: feature %u not registered\n", feature_id);
-        ret = -EOPNOTSUPP;
-        goto out;
+        return -EOPNOTSUPP;
     }
 
     if (!handler->set_handler) {
         pr_warn("feature: no set_handler for feature %u\n", feature_id);
-        ret = -EOPNOTSUPP;
-        goto out;
+        return -EOPNOTSUPP;
     }
 
     ret = handler->set_handler(value);
@@ -142,11 +140,32 @@ int ksu_set_feature(u32 feature_id, u64 value)
         pr_err("feature: set_handler for %u failed: %d\n", feature_id, ret);
     }
 
-out:
+    return ret;
+}
+
+int ksu_set_feature(u32 feature_id, u64 value)
+{
+    int ret;
+
+    mutex_lock(&feature_mutex);
+    ret = __ksu_set_feature(feature_id, value);
     mutex_unlock(&feature_mutex);
+
     return ret;
 }
 
+void ksu_set_features(struct ksu_feature_entry *entries, u32 count)
+{
+    u32 i;
+
+    // one lock round for the whole batch, entries still apply in order
+    mutex_lock(&feature_mutex);
+    for (i = 0; i < count; i++)
+        entries[i].result =
+            __ksu_set_feature(entries[i].feature_id, entries[i].value);
+    mutex_unlock(&feature_mutex);
+}
+
 void ksu_feature_init(void)
 {
     int i;
@@ -165,7 +184,7 @@ void ksu_feature_exit(void)
     mutex_lock(&feature_mutex);
 
     for (i = 0; i < KSU_FEATURE_MAX; i++) {
-        feature_handlers[i] = NULL;
+        WRITE_ONCE(feature_handlers[i], NULL);
     }
 
     mutex_unlock(&feature_mutex);
@@ -7,6 +7,8 @@ enum ksu_feature_id {
     KSU_FEATURE_SU_COMPAT = 0,
     KSU_FEATURE_KERNEL_UMOUNT = 1,
     KSU_FEATURE_SULOG = 3,
+    KSU_FEATURE_CLEAN_MNT_NS = 4,
+    KSU_FEATURE_HOOK_STATS = 5,
 
     KSU_FEATURE_MAX
 };
@@ -29,6 +31,11 @@ int ksu_get_feature(u32 feature_id, u64 *value, bool *supported);
 
 int ksu_set_feature(u32 feature_id, u64 value);
 
+struct ksu_feature_entry;
+
+// Apply a batch under one lock, each entry gets its own result
+void ksu_set_features(struct ksu_feature_entry *entries, u32 count);
+
 void ksu_feature_init(void);
 
 void ksu_feature_exit(void);
@@ -9,8 +9,11 @@
 #include <linux/file.h>
 #include <linux/module.h>
 #include <linux/fs.h>
+#include <linux/hashtable.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/splice.h>
 #include <linux/uaccess.h>
 #include <linux/version.h>
 #include <linux/mount.h>
@@ -19,9 +22,22 @@
 #include "objsec.h"
 #include "ksud.h"
 
+// Wrapper ops only depend on the original f_op, so every wrapper of a file
+// with the same f_op (all the tty fds of su sessions) shares one table
+struct ksu_wrapper_ops {
+    struct hlist_node hash;
+    const struct file_operations *orig_fops;
+    int refs; // protected by ksu_wrapper_ops_lock
+    struct file_operations ops;
+};
+
+#define KSU_WRAPPER_OPS_HASH_BITS 4
+static DEFINE_HASHTABLE(ksu_wrapper_ops_table, KSU_WRAPPER_OPS_HASH_BITS);
+static DEFINE_SPINLOCK(ksu_wrapper_ops_lock);
+
 struct ksu_file_wrapper {
     struct file *orig;
-    struct file_operations ops;
+    struct ksu_wrapper_ops *ops;
 };
 
 static struct ksu_file_wrapper *ksu_create_file_wrapper(struct file *fp);
@@ -40,7 +56,7 @@ static int ksu_wrapper_open(struct inode *ino, struct file *fp)
         return PTR_ERR(wrapper);
     }
     fp->private_data = wrapper;
-    const struct file_operations *new_fops = fops_get(&wrapper->ops);
+    const struct file_operations *new_fops = fops_get(&wrapper->ops->ops);
     replace_fops(fp, new_fops);
     return 0;
 }
@@ -228,6 +244,11 @@ static int ksu_wrapper_flock(struct file *fp, int arg1, struct file_lock *fl)
     return -EINVAL;
 }
 
+// Pipes have no splice ops of their own. splice(2) only takes a real pipe
+// (pipefifo_fops) as its pipe end, so a wrapped pipe still can't be used
+// there. What these ops keep working is the file side: sendfile and
+// do_splice_direct, which go through an internal pipe and call the ops of
+// the file, now fall back to the original file instead of -EINVAL.
 static ssize_t ksu_wrapper_splice_write(struct pipe_inode_info *pii,
                                         struct file *fp, loff_t *off, size_t sz,
                                         unsigned int arg1)
@@ -237,6 +258,11 @@ static ssize_t ksu_wrapper_splice_write(struct pipe_inode_info *pii,
     if (orig->f_op->splice_write) {
         return orig->f_op->splice_write(pii, orig, off, sz, arg1);
     }
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 16, 0)
+    if (orig->f_op->write_iter) {
+        return iter_file_splice_write(pii, orig, off, sz, arg1);
+    }
+#endif
     return -EINVAL;
 }
 
@@ -249,6 +275,16 @@ static ssize_t ksu_wrapper_splice_read(struct file *fp, loff_t *off,
     if (orig->f_op->splice_read) {
         return orig->f_op->splice_read(orig, off, pii, sz, arg1);
     }
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 5, 0)
+    // vfs_splice_read would refuse a file without splice_read
+    if (orig->f_op->read_iter) {
+        return copy_splice_read(orig, off, pii, sz, arg1);
+    }
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3, 16, 0)
+    if (orig->f_op->read_iter) {
+        return generic_file_splice_read(orig, off, pii, sz, arg1);
+    }
+#endif
     return -EINVAL;
 }
 
@@ -344,6 +380,8 @@ static int ksu_wrapper_show_fdinfo(struct seq_file *m, struct file *f)
 #endif
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 7, 0)
+static int ksu_wrapper_release(struct inode *inode, struct file *filp);
+
 // https://cs.android.com/android/kernel/superproject/+/common-android-mainline:common/fs/read_write.c;l=1593-1606;drc=398da7defe218d3e51b0f3bdff75147e28125b60
 static ssize_t ksu_wrapper_copy_file_range(struct file *file_in, loff_t pos_in,
                                            struct file *file_out,
@@ -352,6 +390,16 @@ static ssize_t ksu_wrapper_copy_file_range(struct file *file_in, loff_t pos_in,
 {
     struct ksu_file_wrapper *data = file_out->private_data;
     struct file *orig = data->orig;
+
+    // both ends may be wrapped, the filesystem must only see real files
+    if (file_in->f_op->release == ksu_wrapper_release) {
+        data = file_in->private_data;
+        file_in = data->orig;
+    }
+    // let the VFS fall back to splice across filesystems
+    if (file_in->f_op->copy_file_range != orig->f_op->copy_file_range) {
+        return -EXDEV;
+    }
     return orig->f_op->copy_file_range(file_in, pos_in, orig, pos_out, len,
                                        flags);
 }
@@ -408,78 +456,158 @@ static int ksu_wrapper_release(struct inode *inode, struct file *filp)
     return 0;
 }
 
-static struct ksu_file_wrapper *ksu_create_file_wrapper(struct file *fp)
+static void ksu_fill_wrapper_ops(struct file_operations *ops,
+                                 const struct file_operations *orig)
 {
-    struct ksu_file_wrapper *p =
-        kcalloc(1, sizeof(struct ksu_file_wrapper), GFP_KERNEL);
-    if (!p) {
-        return ERR_PTR(-ENOMEM);
-    }
-
-    get_file(fp);
-
-    p->orig = fp;
-    p->ops.owner = THIS_MODULE;
-    p->ops.llseek = fp->f_op->llseek ? ksu_wrapper_llseek : NULL;
-    p->ops.read = fp->f_op->read ? ksu_wrapper_read : NULL;
-    p->ops.write = fp->f_op->write ? ksu_wrapper_write : NULL;
+    ops->owner = THIS_MODULE;
+    ops->llseek = orig->llseek ? ksu_wrapper_llseek : NULL;
+    ops->read = orig->read ? ksu_wrapper_read : NULL;
+    ops->write = orig->write ? ksu_wrapper_write : NULL;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 16, 0)
-    p->ops.read_iter = fp->f_op->read_iter ? ksu_wrapper_read_iter : NULL;
-    p->ops.write_iter = fp->f_op->write_iter ? ksu_wrapper_write_iter : NULL;
+    ops->read_iter = orig->read_iter ? ksu_wrapper_read_iter : NULL;
+    ops->write_iter = orig->write_iter ? ksu_wrapper_write_iter : NULL;
 #endif
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
-    p->ops.iopoll = fp->f_op->iopoll ? ksu_wrapper_iopoll : NULL;
+    ops->iopoll = orig->iopoll ? ksu_wrapper_iopoll : NULL;
 #endif
 #if LINUX_VERSION_CODE < KERNEL_VERSION(6, 6, 0)
-    p->ops.iterate = fp->f_op->iterate ? ksu_wrapper_iterate : NULL;
+    ops->iterate = orig->iterate ? ksu_wrapper_iterate : NULL;
 #endif
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 7, 0)
-    p->ops.iterate_shared =
-        fp->f_op->iterate_shared ? ksu_wrapper_iterate_shared : NULL;
+    ops->iterate_shared =
+        orig->iterate_shared ? ksu_wrapper_iterate_shared : NULL;
 #endif
-    p->ops.poll = fp->f_op->poll ? ksu_wrapper_poll : NULL;
-    p->ops.unlocked_ioctl =
-        fp->f_op->unlocked_ioctl ? ksu_wrapper_unlocked_ioctl : NULL;
-    p->ops.compat_ioctl =
-        fp->f_op->compat_ioctl ? ksu_wrapper_compat_ioctl : NULL;
-    p->ops.mmap = fp->f_op->mmap ? ksu_wrapper_mmap : NULL;
+    ops->poll = orig->poll ? ksu_wrapper_poll : NULL;
+    ops->unlocked_ioctl =
+        orig->unlocked_ioctl ? ksu_wrapper_unlocked_ioctl : NULL;
+    ops->compat_ioctl = orig->compat_ioctl ? ksu_wrapper_compat_ioctl : NULL;
+    ops->mmap = orig->mmap ? ksu_wrapper_mmap : NULL;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
-    p->ops.fop_flags = fp->f_op->fop_flags;
+    ops->fop_flags = orig->fop_flags;
 #elif LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
-    p->ops.mmap_supported_flags = fp->f_op->mmap_supported_flags;
+    ops->mmap_supported_flags = orig->mmap_supported_flags;
 #endif
-    p->ops.flush = fp->f_op->flush ? ksu_wrapper_flush : NULL;
-    p->ops.release = ksu_wrapper_release;
-    p->ops.fsync = fp->f_op->fsync ? ksu_wrapper_fsync : NULL;
-    p->ops.fasync = fp->f_op->fasync ? ksu_wrapper_fasync : NULL;
-    p->ops.lock = fp->f_op->lock ? ksu_wrapper_lock : NULL;
+    ops->flush = orig->flush ? ksu_wrapper_flush : NULL;
+    ops->release = ksu_wrapper_release;
+    ops->fsync = orig->fsync ? ksu_wrapper_fsync : NULL;
+    ops->fasync = orig->fasync ? ksu_wrapper_fasync : NULL;
+    ops->lock = orig->lock ? ksu_wrapper_lock : NULL;
 #if LINUX_VERSION_CODE < KERNEL_VERSION(6, 6, 0)
-    p->ops.sendpage = fp->f_op->sendpage ? ksu_wrapper_sendpage : NULL;
+    ops->sendpage = orig->sendpage ? ksu_wrapper_sendpage : NULL;
+#endif
+    ops->get_unmapped_area =
+        orig->get_unmapped_area ? ksu_wrapper_get_unmapped_area : NULL;
+    ops->check_flags = orig->check_flags;
+    ops->flock = orig->flock ? ksu_wrapper_flock : NULL;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 16, 0)
+    ops->splice_write = orig->splice_write || orig->write_iter ?
+                            ksu_wrapper_splice_write :
+                            NULL;
+    ops->splice_read = orig->splice_read || orig->read_iter ?
+                           ksu_wrapper_splice_read :
+                           NULL;
+#else
+    ops->splice_write = orig->splice_write ? ksu_wrapper_splice_write : NULL;
+    ops->splice_read = orig->splice_read ? ksu_wrapper_splice_read : NULL;
 #endif
-    p->ops.get_unmapped_area =
-        fp->f_op->get_unmapped_area ? ksu_wrapper_get_unmapped_area : NULL;
-    p->ops.check_flags = fp->f_op->check_flags;
-    p->ops.flock = fp->f_op->flock ? ksu_wrapper_flock : NULL;
-    p->ops.splice_write =
-        fp->f_op->splice_write ? ksu_wrapper_splice_write : NULL;
-    p->ops.splice_read = fp->f_op->splice_read ? ksu_wrapper_splice_read : NULL;
-    p->ops.setlease = fp->f_op->setlease ? ksu_wrapper_setlease : NULL;
-    p->ops.fallocate = fp->f_op->fallocate ? ksu_wrapper_fallocate : NULL;
-    p->ops.show_fdinfo = fp->f_op->show_fdinfo ? ksu_wrapper_show_fdinfo : NULL;
+    ops->setlease = orig->setlease ? ksu_wrapper_setlease : NULL;
+    ops->fallocate = orig->fallocate ? ksu_wrapper_fallocate : NULL;
+    ops->show_fdinfo = orig->show_fdinfo ? ksu_wrapper_show_fdinfo : NULL;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 7, 0)
-    p->ops.copy_file_range =
-        fp->f_op->copy_file_range ? ksu_wrapper_copy_file_range : NULL;
+    ops->copy_file_range =
+        orig->copy_file_range ? ksu_wrapper_copy_file_range : NULL;
 #endif
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 20, 0)
-    p->ops.remap_file_range =
-        fp->f_op->remap_file_range ? ksu_wrapper_remap_file_range : NULL;
+    ops->remap_file_range =
+        orig->remap_file_range ? ksu_wrapper_remap_file_range : NULL;
 #endif
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 19, 0)
-    p->ops.fadvise = fp->f_op->fadvise ? ksu_wrapper_fadvise : NULL;
+    ops->fadvise = orig->fadvise ? ksu_wrapper_fadvise : NULL;
 #endif
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
-    p->ops.splice_eof = fp->f_op->splice_eof ? ksu_wrapper_splice_eof : NULL;
+    ops->splice_eof = orig->splice_eof ? ksu_wrapper_splice_eof : NULL;
 #endif
+}
+
+static struct ksu_wrapper_ops *
+ksu_find_wrapper_ops_locked(const struct file_operations *orig_fops)
+{
+    struct ksu_wrapper_ops *node;
+
+    hash_for_each_possible (ksu_wrapper_ops_table, node, hash,
+                            (unsigned long)orig_fops) {
+        if (node->orig_fops == orig_fops)
+            return node;
+    }
+
+    return NULL;
+}
+
+static struct ksu_wrapper_ops *
+ksu_get_wrapper_ops(const struct file_operations *orig_fops)
+{
+    struct ksu_wrapper_ops *node, *new_node;
+
+    spin_lock(&ksu_wrapper_ops_lock);
+    node = ksu_find_wrapper_ops_locked(orig_fops);
+    if (node)
+        node->refs++;
+    spin_unlock(&ksu_wrapper_ops_lock);
+    if (node)
+        return node;
+
+    new_node = kzalloc(sizeof(*new_node), GFP_KERNEL);
+    if (!new_node)
+        return NULL;
+    new_node->orig_fops = orig_fops;
+    new_node->refs = 1;
+    ksu_fill_wrapper_ops(&new_node->ops, orig_fops);
+
+    spin_lock(&ksu_wrapper_ops_lock);
+    node = ksu_find_wrapper_ops_locked(orig_fops);
+    if (node)
+        node->refs++;
+    else
+        hash_add(ksu_wrapper_ops_table, &new_node->hash,
+                 (unsigned long)orig_fops);
+    spin_unlock(&ksu_wrapper_ops_lock);
+
+    if (!node)
+        return new_node;
+    kfree(new_node);
+    return node;
+}
+
+static void ksu_put_wrapper_ops(struct ksu_wrapper_ops *node)
+{
+    bool last;
+
+    spin_lock(&ksu_wrapper_ops_lock);
+    last = --node->refs == 0;
+    if (last)
+        hash_del(&node->hash);
+    spin_unlock(&ksu_wrapper_ops_lock);
+
+    if (last)
+        kfree(node);
+}
+
+static struct ksu_file_wrapper *ksu_create_file_wrapper(struct file *fp)
+{
+    struct ksu_file_wrapper *p =
+        kcalloc(1, sizeof(struct ksu_file_wrapper), GFP_KERNEL);
+    if (!p) {
+        return ERR_PTR(-ENOMEM);
+    }
+
+    p->ops = ksu_get_wrapper_ops(fp->f_op);
+    if (!p->ops) {
+        kfree(p);
+        return ERR_PTR(-ENOMEM);
+    }
+
+    get_file(fp);
+    p->orig = fp;
 
     return p;
 }
@@ -487,6 +615,7 @@ static struct ksu_file_wrapper *ksu_create_file_wrapper(struct file *fp)
 static void ksu_release_file_wrapper(struct ksu_file_wrapper *data)
 {
     fput((struct file *)data->orig);
+    ksu_put_wrapper_ops(data->ops);
     kfree(data);
 }
 
@@ -612,7 +741,7 @@ int ksu_install_file_wrapper(int fd)
     }
 
     struct file *wrapper_file = ksu_anon_inode_create_getfile_compat(
-        "[ksu_fdwrapper]", &file_wrapper_data->ops, file_wrapper_data,
+        "[ksu_fdwrapper]", &file_wrapper_data->ops->ops, file_wrapper_data,
         orig_file->f_flags, NULL);
     if (IS_ERR(wrapper_file)) {
         pr_err("ksu_fdwrapper: getfile failed: %ld\n", PTR_ERR(wrapper_file));
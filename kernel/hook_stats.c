@@ -0,0 +1,136 @@
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/percpu.h>
+#include <linux/string.h>
+
+#include "hook_stats.h"
+#include "feature.h"
+#include "klog.h" // IWYU pragma: keep
+#include "supercalls.h"
+
+struct ksu_hook_stat {
+    u64 count;
+    u64 total_ns;
+    u64 hist[KSU_STATS_BUCKETS];
+};
+
+struct ksu_hook_stats {
+    struct ksu_hook_stat slot[KSU_HOOK_SLOTS];
+};
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 3, 0)
+DEFINE_STATIC_KEY_FALSE(ksu_hook_stats_key);
+#define hook_stats_key (&ksu_hook_stats_key.key)
+#else
+struct static_key ksu_hook_stats_key = STATIC_KEY_INIT_FALSE;
+#define hook_stats_key (&ksu_hook_stats_key)
+#endif
+
+static const char *const hook_names[KSU_HOOK_IOCTL_BASE] = {
+    [KSU_HOOK_SETUID] = "setuid",
+    [KSU_HOOK_UMOUNT] = "umount",
+    [KSU_HOOK_STAT] = "stat",
+    [KSU_HOOK_FACCESSAT] = "faccessat",
+    [KSU_HOOK_EXECVE_SU] = "execve_su",
+    [KSU_HOOK_ESCAPE_ROOT] = "escape_with_root_profile",
+    [KSU_HOOK_TRACK_THRONE] = "track_throne",
+};
+
+static struct ksu_hook_stats __percpu *hook_stats;
+static bool hook_stats_enabled;
+
+void __ksu_hook_stats_record(u32 slot, u64 start)
+{
+    u64 delta = ktime_get_ns() - start;
+    struct ksu_hook_stats *stats;
+    struct ksu_hook_stat *stat;
+
+    if (unlikely(slot >= KSU_HOOK_SLOTS))
+        return;
+
+    stats = get_cpu_ptr(hook_stats);
+    stat = &stats->slot[slot];
+    stat->count++;
+    stat->total_ns += delta;
+    stat->hist[delta ? min_t(u32, ilog2(delta), KSU_STATS_BUCKETS - 1) : 0]++;
+    put_cpu_ptr(hook_stats);
+}
+
+void ksu_hook_stats_read(u32 slot, const char *name,
+                         struct ksu_hook_stats_entry *entry, bool reset)
+{
+    struct ksu_hook_stat *stat;
+    int cpu, i;
+
+    memset(entry, 0, sizeof(*entry));
+    if (!name && slot < KSU_HOOK_IOCTL_BASE)
+        name = hook_names[slot];
+    snprintf(entry->name, sizeof(entry->name), "%s", name ? name : "");
+
+    if (!hook_stats || slot >= KSU_HOOK_SLOTS)
+        return;
+
+    // counters of other CPUs are read racily, good enough for stats
+    for_each_possible_cpu (cpu) {
+        stat = &per_cpu_ptr(hook_stats, cpu)->slot[slot];
+        entry->count += stat->count;
+        entry->total_ns += stat->total_ns;
+        for (i = 0; i < KSU_STATS_BUCKETS; i++)
+            entry->hist[i] += stat->hist[i];
+        if (reset)
+            memset(stat, 0, sizeof(*stat));
+    }
+}
+
+static int hook_stats_feature_get(u64 *value)
+{
+    *value = hook_stats_enabled ? 1 : 0;
+    return 0;
+}
+
+static int hook_stats_feature_set(u64 value)
+{
+    bool enable = value != 0;
+
+    if (enable == hook_stats_enabled)
+        return 0;
+    if (enable && !hook_stats)
+        return -ENOMEM;
+
+    if (enable)
+        static_key_slow_inc(hook_stats_key);
+    else
+        static_key_slow_dec(hook_stats_key);
+    hook_stats_enabled = enable;
+    pr_info("hook_stats: set to %d\n", enable);
+    return 0;
+}
+
+static const struct ksu_feature_handler hook_stats_handler = {
+    .feature_id = KSU_FEATURE_HOOK_STATS,
+    .name = "hook_stats",
+    .get_handler = hook_stats_feature_get,
+    .set_handler = hook_stats_feature_set,
+};
+
+void ksu_hook_stats_init(void)
+{
+    hook_stats = alloc_percpu(struct ksu_hook_stats);
+    if (!hook_stats)
+        pr_err("hook_stats: failed to allocate counters\n");
+
+    if (ksu_register_feature_handler(&hook_stats_handler)) {
+        pr_err("Failed to register hook_stats feature handler\n");
+    }
+}
+
+void ksu_hook_stats_exit(void)
+{
+    ksu_unregister_feature_handler(KSU_FEATURE_HOOK_STATS);
+    if (hook_stats_enabled) {
+        static_key_slow_dec(hook_stats_key);
+        hook_stats_enabled = false;
+    }
+    free_percpu(hook_stats);
+    hook_stats = NULL;
+}
@@ -0,0 +1,59 @@
+#ifndef __KSU_H_HOOK_STATS
+#define __KSU_H_HOOK_STATS
+
+#include <linux/types.h>
+#include <linux/jump_label.h>
+#include <linux/ktime.h>
+#include <linux/version.h>
+
+enum ksu_hook_id {
+    KSU_HOOK_SETUID = 0,
+    KSU_HOOK_UMOUNT,
+    KSU_HOOK_STAT,
+    KSU_HOOK_FACCESSAT,
+    KSU_HOOK_EXECVE_SU,
+    KSU_HOOK_ESCAPE_ROOT,
+    KSU_HOOK_TRACK_THRONE,
+
+    // followed by one slot per ksu_ioctl_handlers entry
+    KSU_HOOK_IOCTL_BASE
+};
+
+#define KSU_HOOK_MAX_IOCTLS 40
+#define KSU_HOOK_SLOTS (KSU_HOOK_IOCTL_BASE + KSU_HOOK_MAX_IOCTLS)
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 3, 0)
+DECLARE_STATIC_KEY_FALSE(ksu_hook_stats_key);
+#define ksu_hook_stats_enabled() static_branch_unlikely(&ksu_hook_stats_key)
+#else
+extern struct static_key ksu_hook_stats_key;
+#define ksu_hook_stats_enabled() static_key_false(&ksu_hook_stats_key)
+#endif
+
+void __ksu_hook_stats_record(u32 slot, u64 start);
+
+// With stats off both helpers are a patched out branch
+static __always_inline u64 ksu_hook_stats_start(void)
+{
+    if (ksu_hook_stats_enabled())
+        return ktime_get_ns();
+    return 0;
+}
+
+static __always_inline void ksu_hook_stats_end(u32 slot, u64 start)
+{
+    // start is 0 when stats were switched on mid call
+    if (ksu_hook_stats_enabled() && start)
+        __ksu_hook_stats_record(slot, start);
+}
+
+struct ksu_hook_stats_entry;
+
+// Sum one slot over all CPUs, ioctl slots pass the ioctl name
+void ksu_hook_stats_read(u32 slot, const char *name,
+                         struct ksu_hook_stats_entry *entry, bool reset);
+
+void ksu_hook_stats_init(void);
+void ksu_hook_stats_exit(void);
+
+#endif // __KSU_H_HOOK_STATS
@@ -9,8 +9,11 @@
 #include <linux/nsproxy.h>
 #include <linux/path.h>
 #include <linux/printk.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
 #include <linux/types.h>
 #include <linux/uaccess.h>
+#include <../fs/mount.h>
 
 #ifndef KSU_HAS_PATH_UMOUNT
 #include <linux/syscalls.h>
@@ -22,6 +25,8 @@
 
 #include "manager.h"
 #include "kernel_umount.h"
+#include "hook_stats.h"
+#include "ksu_trace.h"
 #include "klog.h" // IWYU pragma: keep
 #include "kernel_compat.h"
 #include "allowlist.h"
@@ -29,6 +34,7 @@
 #include "feature.h"
 #include "ksud.h"
 #include "ksu.h"
+#include "umount_ns.h"
 
 #include "sulog.h"
 
@@ -111,6 +117,133 @@ void try_umount(const char *mnt, int flags)
     ksu_umount_mnt(mnt, &path, flags);
 }
 
+// mount_list compiled deepest-first, so nested mounts go before their parents
+static struct mount_entry **umount_plan;
+static int umount_plan_count;
+
+// mount namespaces already cleaned with the current plan, keyed by
+// mnt_namespace->seq. Addresses and inode numbers get reused once a
+// namespace dies, seq never repeats within a boot and starts at 1, so
+// 0 marks an empty slot and no reference has to be held.
+#define UMOUNT_CLEANED_NS_MAX 16
+static u64 umount_cleaned_ns[UMOUNT_CLEANED_NS_MAX];
+static unsigned int umount_cleaned_next;
+static DEFINE_SPINLOCK(umount_cleaned_lock);
+
+static int umount_path_depth(const char *path)
+{
+    int depth = 0;
+    const char *p;
+
+    for (p = path; *p; p++) {
+        if (*p == '/' && p[1] && p[1] != '/')
+            depth++;
+    }
+    return depth;
+}
+
+static u64 umount_ns_seq_of_current(void)
+{
+    // only current replaces its own nsproxy, no lock needed to read it
+    struct nsproxy *nsp = current->nsproxy;
+
+    if (!nsp || !nsp->mnt_ns)
+        return 0;
+    return nsp->mnt_ns->seq;
+}
+
+static bool umount_ns_is_cleaned(u64 seq)
+{
+    bool found = false;
+    int i;
+
+    spin_lock(&umount_cleaned_lock);
+    for (i = 0; i < UMOUNT_CLEANED_NS_MAX; i++) {
+        if (umount_cleaned_ns[i] == seq) {
+            found = true;
+            break;
+        }
+    }
+    spin_unlock(&umount_cleaned_lock);
+    return found;
+}
+
+static void umount_mark_ns_cleaned(u64 seq)
+{
+    spin_lock(&umount_cleaned_lock);
+    umount_cleaned_ns[umount_cleaned_next] = seq;
+    umount_cleaned_next = (umount_cleaned_next + 1) % UMOUNT_CLEANED_NS_MAX;
+    spin_unlock(&umount_cleaned_lock);
+}
+
+void ksu_umount_forget_cleaned_ns(void)
+{
+    spin_lock(&umount_cleaned_lock);
+    memset(umount_cleaned_ns, 0, sizeof(umount_cleaned_ns));
+    spin_unlock(&umount_cleaned_lock);
+}
+
+void ksu_umount_plan_rebuild(void)
+{
+    struct mount_entry **plan = NULL;
+    struct mount_entry *entry;
+    int count = 0, i = 0, j;
+
+    list_for_each_entry (entry, &mount_list, list) {
+        entry->depth = umount_path_depth(entry->umountable);
+        count++;
+    }
+
+    if (count) {
+        plan = kmalloc_array(count, sizeof(*plan), GFP_KERNEL);
+        if (!plan)
+            pr_warn("umount plan: alloc failed, walking the list\n");
+    }
+
+    if (plan) {
+        // insertion sort keeps list order between entries of equal depth
+        list_for_each_entry (entry, &mount_list, list) {
+            for (j = i; j > 0 && plan[j - 1]->depth < entry->depth; j--)
+                plan[j] = plan[j - 1];
+            plan[j] = entry;
+            i++;
+        }
+    }
+
+    kfree(umount_plan);
+    umount_plan = plan;
+    umount_plan_count = plan ? count : 0;
+
+    // also forgets the cleaned namespaces
+    ksu_umount_ns_invalidate();
+}
+
+// caller holds mount_list_lock
+static void umount_run_plan(void)
+{
+    struct mount_entry *entry;
+    int i;
+
+    if (!umount_plan) {
+        list_for_each_entry (entry, &mount_list, list) {
+            try_umount(entry->umountable, entry->flags);
+        }
+        return;
+    }
+
+    for (i = 0; i < umount_plan_count; i++) {
+        entry = umount_plan[i];
+        try_umount(entry->umountable, entry->flags);
+    }
+}
+
+void ksu_umount_all(void)
+{
+    down_read(&mount_list_lock);
+    umount_run_plan();
+    up_read(&mount_list_lock);
+}
+
 struct umount_tw {
     struct callback_head cb;
 };
@@ -122,17 +255,32 @@ extern void susfs_run_sus_path_loop(void);
 static void umount_tw_func(struct callback_head *cb)
 {
     struct umount_tw *tw = container_of(cb, struct umount_tw, cb);
-    const struct cred *saved = override_creds(ksu_cred);
+    const struct cred *saved;
+    u64 ns_seq;
+    int result = KSU_UMOUNT_SWITCHED_NS;
 
-    struct mount_entry *entry;
+    trace_ksu_umount_start(current_uid().val);
+    saved = override_creds(ksu_cred);
+
+    if (ksu_umount_ns_try_switch())
+        goto umount_done;
+
+    // isolated processes and app zygote children may share a namespace
+    // which was already cleaned, don't redo the lookups for them
+    ns_seq = umount_ns_seq_of_current();
     down_read(&mount_list_lock);
-    list_for_each_entry (entry, &mount_list, list) {
-        pr_info("%s: unmounting: %s flags 0x%x\n", __func__, entry->umountable,
-                entry->flags);
-        try_umount(entry->umountable, entry->flags);
+    if (ns_seq && umount_ns_is_cleaned(ns_seq)) {
+        result = KSU_UMOUNT_ALREADY_CLEAN;
+    } else {
+        result = KSU_UMOUNT_UNMOUNTED;
+        umount_run_plan();
+        if (ns_seq)
+            umount_mark_ns_cleaned(ns_seq);
     }
     up_read(&mount_list_lock);
 
+umount_done:
+
 #ifdef CONFIG_KSU_SUSFS_SUS_PATH
     // susfs_run_sus_path_loop() runs here with ksu_cred so that it can reach all the paths.
 
@@ -140,11 +288,12 @@ static void umount_tw_func(struct callback_head *cb)
 #endif // #ifdef CONFIG_KSU_SUSFS_SUS_PATH
 
     revert_creds(saved);
+    trace_ksu_umount_end(result);
 
     kfree(tw);
 }
 
-int ksu_handle_umount(uid_t old_uid, uid_t new_uid)
+static int __ksu_handle_umount(uid_t old_uid, uid_t new_uid)
 {
     struct umount_tw *tw;
 
@@ -178,8 +327,6 @@ int ksu_handle_umount(uid_t old_uid, uid_t new_uid)
     }
 
     // umount the target mnt
-    pr_info("handle umount for uid: %d, pid: %d\n", new_uid, current->pid);
-
     tw = kzalloc(sizeof(*tw), GFP_ATOMIC);
     if (!tw)
         return 0;
@@ -201,14 +348,32 @@ skip_umount_task:
     return 0;
 }
 
+int ksu_handle_umount(uid_t old_uid, uid_t new_uid)
+{
+    u64 start = ksu_hook_stats_start();
+    int ret = __ksu_handle_umount(old_uid, new_uid);
+
+    ksu_hook_stats_end(KSU_HOOK_UMOUNT, start);
+    return ret;
+}
+
 void ksu_kernel_umount_init(void)
 {
     if (ksu_register_feature_handler(&kernel_umount_handler)) {
         pr_err("Failed to register kernel_umount feature handler\n");
     }
+    ksu_umount_ns_init();
 }
 
 void ksu_kernel_umount_exit(void)
 {
+    ksu_umount_ns_exit();
+    ksu_umount_forget_cleaned_ns();
+
+    down_write(&mount_list_lock);
+    kfree(umount_plan);
+    umount_plan = NULL;
+    umount_plan_count = 0;
+    up_write(&mount_list_lock);
     ksu_unregister_feature_handler(KSU_FEATURE_KERNEL_UMOUNT);
 }
@@ -15,11 +15,23 @@ int ksu_handle_umount(uid_t old_uid, uid_t new_uid);
 struct mount_entry {
     char *umountable;
     unsigned int flags;
+    int depth; // path components, filled in by ksu_umount_plan_rebuild
     struct list_head list;
+    struct hlist_node hnode; // dedup while loading a batch
 };
 extern struct list_head mount_list;
 extern struct rw_semaphore mount_list_lock;
 
 void try_umount(const char *mnt, int flags);
 
+// Recompile the deepest-first umount plan, caller holds mount_list_lock
+// for writing. Also forgets which namespaces were already cleaned.
+void ksu_umount_plan_rebuild(void);
+
+// Forget which namespaces were already cleaned, they may have new mounts
+void ksu_umount_forget_cleaned_ns(void);
+
+// Umount every entry of the plan in the current mount namespace
+void ksu_umount_all(void);
+
 #endif
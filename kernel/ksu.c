@@ -11,8 +11,10 @@
 #endif
 
 #include "allowlist.h"
+#include "apk_sign.h"
 #include "ksu.h"
 #include "feature.h"
+#include "hook_stats.h"
 #include "klog.h" // IWYU pragma: keep
 #include "throne_tracker.h"
 #ifndef KSU_TP_HOOK
@@ -29,6 +31,7 @@ struct cred *ksu_cred;
 #include "dynamic_manager.h"
 #include "sucompat.h"
 #include "setuid_hook.h"
+#include "su_mount_ns.h"
 
 void sukisu_custom_config_init(void)
 {
@@ -64,6 +67,8 @@ int __init kernelsu_init(void)
 
     ksu_feature_init();
 
+    ksu_hook_stats_init();
+
 #ifdef CONFIG_KSU_MANUAL_HOOK
 #if LINUX_VERSION_CODE < KERNEL_VERSION(6, 8, 0)
     ksu_lsm_hook_init();
@@ -79,6 +84,8 @@ int __init kernelsu_init(void)
     ksu_setuid_hook_init();
     ksu_sucompat_init();
 
+    ksu_apk_sign_init();
+
     ksu_allowlist_init();
 
     ksu_throne_tracker_init();
@@ -108,17 +115,22 @@ void kernelsu_exit(void)
 
     ksu_throne_tracker_exit();
 
+    ksu_apk_sign_exit();
+
 #ifdef KSU_TP_HOOK
     ksu_ksud_exit();
     ksu_syscall_hook_manager_exit();
 #endif
     ksu_sucompat_exit();
     ksu_setuid_hook_exit();
+    ksu_mount_ns_exit();
 
     sukisu_custom_config_exit();
 
     ksu_supercalls_exit();
 
+    ksu_hook_stats_exit();
+
     ksu_feature_exit();
 
     if (ksu_cred) {
@@ -0,0 +1,5 @@
+#include <linux/cred.h>
+#include <linux/sched.h>
+
+#define CREATE_TRACE_POINTS
+#include "ksu_trace.h"
@@ -0,0 +1,217 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM kernelsu
+
+#if !defined(__KSU_H_TRACE) || defined(TRACE_HEADER_MULTI_READ)
+#define __KSU_H_TRACE
+
+#include <linux/cred.h>
+#include <linux/sched.h>
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+#include <linux/version.h>
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+#define ksu_assign_str(dst, src) __assign_str(dst)
+#else
+#define ksu_assign_str(dst, src) __assign_str(dst, src)
+#endif
+
+#ifndef __KSU_TRACE_ENUMS
+#define __KSU_TRACE_ENUMS
+enum ksu_setuid_kind {
+    KSU_SETUID_MANAGER,
+    KSU_SETUID_ALLOWED,
+    KSU_SETUID_OTHER,
+};
+
+enum ksu_umount_result {
+    KSU_UMOUNT_SWITCHED_NS,
+    KSU_UMOUNT_ALREADY_CLEAN,
+    KSU_UMOUNT_UNMOUNTED,
+};
+
+enum ksu_allowlist_op {
+    KSU_ALLOWLIST_SET,
+    KSU_ALLOWLIST_PRUNE,
+};
+#endif
+
+TRACE_DEFINE_ENUM(KSU_SETUID_MANAGER);
+TRACE_DEFINE_ENUM(KSU_SETUID_ALLOWED);
+TRACE_DEFINE_ENUM(KSU_SETUID_OTHER);
+TRACE_DEFINE_ENUM(KSU_UMOUNT_SWITCHED_NS);
+TRACE_DEFINE_ENUM(KSU_UMOUNT_ALREADY_CLEAN);
+TRACE_DEFINE_ENUM(KSU_UMOUNT_UNMOUNTED);
+TRACE_DEFINE_ENUM(KSU_ALLOWLIST_SET);
+TRACE_DEFINE_ENUM(KSU_ALLOWLIST_PRUNE);
+
+// clang-format off
+TRACE_EVENT(ksu_su_grant,
+    TP_PROTO(uid_t uid, uid_t target_uid, gid_t target_gid),
+    TP_ARGS(uid, target_uid, target_gid),
+    TP_STRUCT__entry(
+        __field(uid_t, uid)
+        __field(uid_t, target_uid)
+        __field(gid_t, target_gid)
+        __field(pid_t, pid)
+    ),
+    TP_fast_assign(
+        __entry->uid = uid;
+        __entry->target_uid = target_uid;
+        __entry->target_gid = target_gid;
+        __entry->pid = current->pid;
+    ),
+    TP_printk("uid=%u pid=%d -> uid=%u gid=%u", __entry->uid, __entry->pid,
+              __entry->target_uid, __entry->target_gid)
+);
+
+TRACE_EVENT(ksu_sucompat_redirect,
+    TP_PROTO(const char *syscall),
+    TP_ARGS(syscall),
+    TP_STRUCT__entry(
+        __field(uid_t, uid)
+        __field(pid_t, pid)
+        __string(syscall, syscall)
+    ),
+    TP_fast_assign(
+        __entry->uid = current_uid().val;
+        __entry->pid = current->pid;
+        ksu_assign_str(syscall, syscall);
+    ),
+    TP_printk("uid=%u pid=%d syscall=%s", __entry->uid, __entry->pid,
+              __get_str(syscall))
+);
+
+TRACE_EVENT(ksu_setuid,
+    TP_PROTO(uid_t old_uid, uid_t new_uid, int kind),
+    TP_ARGS(old_uid, new_uid, kind),
+    TP_STRUCT__entry(
+        __field(uid_t, old_uid)
+        __field(uid_t, new_uid)
+        __field(int, kind)
+    ),
+    TP_fast_assign(
+        __entry->old_uid = old_uid;
+        __entry->new_uid = new_uid;
+        __entry->kind = kind;
+    ),
+    TP_printk("%u -> %u %s", __entry->old_uid, __entry->new_uid,
+              __print_symbolic(__entry->kind,
+                               { KSU_SETUID_MANAGER, "manager" },
+                               { KSU_SETUID_ALLOWED, "allowed" },
+                               { KSU_SETUID_OTHER, "other" }))
+);
+
+TRACE_EVENT(ksu_umount_start,
+    TP_PROTO(uid_t uid),
+    TP_ARGS(uid),
+    TP_STRUCT__entry(
+        __field(uid_t, uid)
+        __field(pid_t, pid)
+    ),
+    TP_fast_assign(
+        __entry->uid = uid;
+        __entry->pid = current->pid;
+    ),
+    TP_printk("uid=%u pid=%d", __entry->uid, __entry->pid)
+);
+
+TRACE_EVENT(ksu_umount_end,
+    TP_PROTO(int result),
+    TP_ARGS(result),
+    TP_STRUCT__entry(
+        __field(pid_t, pid)
+        __field(int, result)
+    ),
+    TP_fast_assign(
+        __entry->pid = current->pid;
+        __entry->result = result;
+    ),
+    TP_printk("pid=%d %s", __entry->pid,
+              __print_symbolic(__entry->result,
+                               { KSU_UMOUNT_SWITCHED_NS, "switched_ns" },
+                               { KSU_UMOUNT_ALREADY_CLEAN, "already_clean" },
+                               { KSU_UMOUNT_UNMOUNTED, "unmounted" }))
+);
+
+TRACE_EVENT(ksu_manager_crowned,
+    TP_PROTO(const char *pkg, uid_t uid, u8 signature_index),
+    TP_ARGS(pkg, uid, signature_index),
+    TP_STRUCT__entry(
+        __string(pkg, pkg)
+        __field(uid_t, uid)
+        __field(u8, signature_index)
+    ),
+    TP_fast_assign(
+        ksu_assign_str(pkg, pkg);
+        __entry->uid = uid;
+        __entry->signature_index = signature_index;
+    ),
+    TP_printk("pkg=%s uid=%u signature_index=%u", __get_str(pkg),
+              __entry->uid, __entry->signature_index)
+);
+
+TRACE_EVENT(ksu_allowlist_change,
+    TP_PROTO(int op, const char *key, uid_t uid, bool allow_su),
+    TP_ARGS(op, key, uid, allow_su),
+    TP_STRUCT__entry(
+        __field(int, op)
+        __string(key, key)
+        __field(uid_t, uid)
+        __field(bool, allow_su)
+    ),
+    TP_fast_assign(
+        __entry->op = op;
+        ksu_assign_str(key, key);
+        __entry->uid = uid;
+        __entry->allow_su = allow_su;
+    ),
+    TP_printk("%s key=%s uid=%u allow_su=%d",
+              __print_symbolic(__entry->op,
+                               { KSU_ALLOWLIST_SET, "set" },
+                               { KSU_ALLOWLIST_PRUNE, "prune" }),
+              __get_str(key), __entry->uid, __entry->allow_su)
+);
+
+TRACE_EVENT(ksu_sepolicy_apply,
+    TP_PROTO(u32 cmd, int ret),
+    TP_ARGS(cmd, ret),
+    TP_STRUCT__entry(
+        __field(u32, cmd)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        __entry->cmd = cmd;
+        __entry->ret = ret;
+    ),
+    TP_printk("cmd=%u ret=%d", __entry->cmd, __entry->ret)
+);
+
+TRACE_EVENT(ksu_mark_process,
+    TP_PROTO(struct task_struct *task, bool marked),
+    TP_ARGS(task, marked),
+    TP_STRUCT__entry(
+        __field(pid_t, pid)
+        __field(uid_t, uid)
+        __array(char, comm, TASK_COMM_LEN)
+        __field(bool, marked)
+    ),
+    TP_fast_assign(
+        __entry->pid = task->pid;
+        __entry->uid = task_uid(task).val;
+        memcpy(__entry->comm, task->comm, TASK_COMM_LEN);
+        __entry->marked = marked;
+    ),
+    TP_printk("pid=%d uid=%u comm=%s %s", __entry->pid, __entry->uid,
+              __entry->comm, __entry->marked ? "marked" : "unmarked")
+);
+// clang-format on
+
+#endif // __KSU_H_TRACE
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ksu_trace
+
+#include <trace/define_trace.h>
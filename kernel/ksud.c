@@ -39,6 +39,7 @@
 #include "kernel_compat.h"
 #include "selinux/selinux.h"
 #include "throne_tracker.h"
+#include "umount_ns.h"
 
 bool ksu_module_mounted __read_mostly = false;
 bool ksu_boot_completed __read_mostly = false;
@@ -130,6 +131,7 @@ void on_module_mounted(void)
 {
     pr_info("on_module_mounted!\n");
     ksu_module_mounted = true;
+    ksu_umount_ns_invalidate();
 }
 
 void on_boot_completed(void)
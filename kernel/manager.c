@@ -77,6 +77,7 @@ void ksu_register_manager(u32 uid, u8 signature_index)
 
     if (ksu_last_manager_appid == KSU_INVALID_APPID)
         ksu_last_manager_appid = appid;
+    ksu_refresh_uid_policy();
     return;
 }
 
@@ -100,6 +101,7 @@ void ksu_unregister_manager(u32 uid)
             list_del_rcu(&pos->list);
             spin_unlock(&ksu_manager_list_write_lock);
             kfree_rcu(pos, rcu);
+            ksu_refresh_uid_policy();
             return;
         }
 
@@ -120,6 +122,7 @@ void ksu_unregister_manager_by_signature_index(u8 signature_index)
 {
     struct ksu_manager_node *node, *pos, *tmp;
     bool mark_another_manager = false;
+    bool removed = false;
     u16 last_each_alive_appid = KSU_INVALID_APPID;
 
     spin_lock(&ksu_manager_list_write_lock);
@@ -131,9 +134,9 @@ void ksu_unregister_manager_by_signature_index(u8 signature_index)
             }
 
             list_del_rcu(&pos->list);
-            spin_unlock(&ksu_manager_list_write_lock);
             kfree_rcu(pos, rcu);
-            return;
+            removed = true;
+            continue;
         }
 
         last_each_alive_appid = pos->appid;
@@ -143,6 +146,8 @@ void ksu_unregister_manager_by_signature_index(u8 signature_index)
 
     if (mark_another_manager)
         ksu_last_manager_appid = last_each_alive_appid;
+    if (removed)
+        ksu_refresh_uid_policy();
     return;
 }
 
@@ -157,6 +162,22 @@ bool ksu_has_manager(void)
     return !empty;
 }
 
+int ksu_get_manager_appids(u16 *appids, int max)
+{
+    struct ksu_manager_node *pos;
+    int count = 0;
+
+    rcu_read_lock();
+    list_for_each_entry_rcu (pos, &ksu_manager_appid_list, list) {
+        if (count < max)
+            appids[count] = pos->appid;
+        count++;
+    }
+    rcu_read_unlock();
+
+    return count;
+}
+
 int ksu_handle_get_managers_cmd(struct ksu_get_managers_cmd __user *arg,
                                 struct ksu_get_managers_cmd *cmd)
 {
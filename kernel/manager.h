@@ -22,6 +22,8 @@ extern void ksu_unregister_manager(u32 uid);
 extern void ksu_unregister_manager_by_signature_index(u8 signature_index);
 extern int ksu_get_manager_signature_index_by_appid(u16 appid);
 extern bool ksu_has_manager(void);
+// Copy up to max manager appids, returns how many are registered
+int ksu_get_manager_appids(u16 *appids, int max);
 
 int ksu_observer_init(void);
 void ksu_observer_exit(void);
@@ -1,6 +1,8 @@
 #ifndef MANAGER_SIGN_H
 #define MANAGER_SIGN_H
 
+#include <linux/types.h>
+
 // weishu/KernelSU
 #define EXPECTED_SIZE_WEISHU 0x033b
 #define EXPECTED_HASH_WEISHU                                                   \
@@ -76,4 +78,13 @@ typedef struct {
     const char *sha256;
 } apk_sign_key_t;
 
+#define KSU_SIGN_DIGEST_SIZE 32
+
+// a signing key as matched at runtime: raw sha256 of the certificate
+struct ksu_sign_digest {
+    u32 size;
+    u8 index;
+    u8 digest[KSU_SIGN_DIGEST_SIZE];
+};
+
 #endif /* MANAGER_SIGN_H */
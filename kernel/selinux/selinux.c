@@ -24,10 +24,8 @@ static u32 cached_zygote_sid __read_mostly = 0;
 static u32 cached_init_sid __read_mostly = 0;
 u32 ksu_file_sid __read_mostly = 0;
 
-static int transive_to_domain(const char *domain, struct cred *cred)
+static int transive_to_sid(u32 sid, struct cred *cred)
 {
-    u32 sid;
-    int error;
 #if LINUX_VERSION_CODE < KERNEL_VERSION(6, 18, 0)
     struct task_security_struct *tsec;
 #else
@@ -38,20 +36,35 @@ static int transive_to_domain(const char *domain, struct cred *cred)
         pr_err("tsec == NULL!\n");
         return -1;
     }
-    error = security_secctx_to_secid(domain, strlen(domain), &sid);
+    tsec->sid = sid;
+    tsec->create_sid = 0;
+    tsec->keycreate_sid = 0;
+    tsec->sockcreate_sid = 0;
+    return 0;
+}
+
+int ksu_domain_to_sid(const char *domain, u32 *sid)
+{
+    int error = security_secctx_to_secid(domain, strlen(domain), sid);
     if (error) {
         pr_info("security_secctx_to_secid %s -> sid: %d, error: %d\n", domain,
-                sid, error);
-    }
-    if (!error) {
-        tsec->sid = sid;
-        tsec->create_sid = 0;
-        tsec->keycreate_sid = 0;
-        tsec->sockcreate_sid = 0;
+                *sid, error);
     }
     return error;
 }
 
+static int transive_to_domain(const char *domain, struct cred *cred)
+{
+    u32 sid;
+    int error;
+
+    error = ksu_domain_to_sid(domain, &sid);
+    if (error) {
+        return error;
+    }
+    return transive_to_sid(sid, cred);
+}
+
 void setup_selinux(const char *domain, struct cred *cred)
 {
     if (transive_to_domain(domain, cred)) {
@@ -60,6 +73,14 @@ void setup_selinux(const char *domain, struct cred *cred)
     }
 }
 
+void setup_selinux_sid(u32 sid, struct cred *cred)
+{
+    if (transive_to_sid(sid, cred)) {
+        pr_err("transive sid failed.\n");
+        return;
+    }
+}
+
 void setup_ksu_cred(void)
 {
     if (ksu_cred && transive_to_domain(KERNEL_SU_CONTEXT, ksu_cred)) {
@@ -21,6 +21,10 @@
 
 void setup_selinux(const char *, struct cred *);
 
+// Resolve a context string once, then transit creds by sid.
+int ksu_domain_to_sid(const char *domain, u32 *sid);
+void setup_selinux_sid(u32 sid, struct cred *cred);
+
 void setenforce(bool);
 
 bool getenforce(void);
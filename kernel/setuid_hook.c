@@ -17,6 +17,8 @@
 
 #include "allowlist.h"
 #include "setuid_hook.h"
+#include "hook_stats.h"
+#include "ksu_trace.h"
 #include "klog.h" // IWYU pragma: keep
 #include "manager.h"
 #include "selinux/selinux.h"
@@ -75,22 +77,23 @@ static inline void ksu_set_ksud_status(uid_t new_uid)
     }
 }
 
-int ksu_handle_setuid(uid_t new_uid, uid_t old_uid, uid_t euid) // (new_euid)
+// euid is the new euid
+static int __ksu_handle_setuid(uid_t new_uid, uid_t old_uid, uid_t euid)
 {
     // We only interest in process spwaned by zygote
     if (!is_zygote(current_cred())) {
         return 0;
     }
 
-    if (old_uid != new_uid) {
-        pr_info("handle_setresuid from %d to %d\n", old_uid, new_uid);
 #if __SULOG_GATE
+    if (old_uid != new_uid) {
         ksu_sulog_report_syscall(new_uid, NULL, "setuid", NULL);
-#endif
     }
+#endif
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
-    if (ksu_is_manager_uid(new_uid)) {
+    if (ksu_get_uid_policy(new_uid) & KSU_UID_POLICY_MANAGER) {
+        trace_ksu_setuid(old_uid, new_uid, KSU_SETUID_MANAGER);
         pr_info("install fd for ksu manager(uid=%d)\n", new_uid);
         ksu_mark_manager(new_uid);
         ksu_set_ksud_status(new_uid);
@@ -105,6 +108,7 @@ int ksu_handle_setuid(uid_t new_uid, uid_t old_uid, uid_t euid) // (new_euid)
     }
 
     if (ksu_is_allow_uid_for_current(new_uid)) {
+        trace_ksu_setuid(old_uid, new_uid, KSU_SETUID_ALLOWED);
         if (current->seccomp.mode == SECCOMP_MODE_FILTER &&
             current->seccomp.filter) {
             spin_lock_irq(&current->sighand->siglock);
@@ -114,12 +118,12 @@ int ksu_handle_setuid(uid_t new_uid, uid_t old_uid, uid_t euid) // (new_euid)
 #ifdef KSU_TP_HOOK
         ksu_set_task_tracepoint_flag(current);
 #endif
-    }
+    } else {
+        trace_ksu_setuid(old_uid, new_uid, KSU_SETUID_OTHER);
 #ifdef KSU_TP_HOOK
-    else {
         ksu_clear_task_tracepoint_flag_if_needed(current);
-    }
 #endif
+    }
 
 #else // #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
     if (ksu_is_allow_uid_for_current(new_uid)) {
@@ -127,15 +131,19 @@ int ksu_handle_setuid(uid_t new_uid, uid_t old_uid, uid_t euid) // (new_euid)
         disable_seccomp(current);
         spin_unlock_irq(&current->sighand->siglock);
 
-        if (ksu_is_manager_uid(new_uid)) {
+        if (ksu_get_uid_policy(new_uid) & KSU_UID_POLICY_MANAGER) {
+            trace_ksu_setuid(old_uid, new_uid, KSU_SETUID_MANAGER);
             pr_info("install fd for ksu manager(uid=%d)\n", new_uid);
             ksu_mark_manager(new_uid);
             ksu_set_ksud_status(new_uid);
             ksu_install_fd();
+        } else {
+            trace_ksu_setuid(old_uid, new_uid, KSU_SETUID_ALLOWED);
         }
 
         return 0;
     }
+    trace_ksu_setuid(old_uid, new_uid, KSU_SETUID_OTHER);
 #endif // #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
 
     // Handle kernel umount
@@ -144,6 +152,15 @@ int ksu_handle_setuid(uid_t new_uid, uid_t old_uid, uid_t euid) // (new_euid)
     return 0;
 }
 
+int ksu_handle_setuid(uid_t new_uid, uid_t old_uid, uid_t euid)
+{
+    u64 start = ksu_hook_stats_start();
+    int ret = __ksu_handle_setuid(new_uid, old_uid, euid);
+
+    ksu_hook_stats_end(KSU_HOOK_SETUID, start);
+    return ret;
+}
+
 int ksu_handle_setresuid(uid_t ruid, uid_t euid, uid_t suid)
 {
 #ifdef CONFIG_KSU_MANUAL_HOOK_AUTO_SETUID_HOOK
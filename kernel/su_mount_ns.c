@@ -1,3 +1,5 @@
+#include <linux/capability.h>
+#include <linux/cred.h>
 #include <linux/dcache.h>
 #include <linux/errno.h>
 #include <linux/fdtable.h>
@@ -5,7 +7,9 @@
 #include <linux/fs.h>
 #include <linux/fs_struct.h>
 #include <linux/limits.h>
+#include <linux/mutex.h>
 #include <linux/namei.h>
+#include <linux/nsproxy.h>
 #include <linux/proc_ns.h>
 #include <linux/pid.h>
 #include <linux/slab.h>
@@ -80,34 +84,142 @@ int ksys_unshare(unsigned long unshare_flags)
 }
 #endif
 
-// global mode , need CAP_SYS_ADMIN and CAP_SYS_CHROOT to perform setns
-static void ksu_mnt_ns_global(void)
+/*
+ * Long-lived reference to init's namespaces, so that global mode doesn't
+ * have to look up PID 1 and open its mnt ns file on every su.
+ * The cache is only refreshed when init's nsproxy pointer changes.
+ */
+static struct task_struct *ksu_init_task;
+static struct nsproxy *ksu_init_nsproxy;
+static DEFINE_MUTEX(ksu_init_ns_mutex);
+
+// returns referenced nsproxy and root of init, NULL if init is unavailable
+static struct nsproxy *ksu_get_init_nsproxy(struct path *root)
 {
-    // save current working directory as absolute path before setns
-    char *pwd_path = NULL;
-    char *pwd_buf = kmalloc(PATH_MAX, GFP_KERNEL);
-    if (!pwd_buf) {
-        pr_warn("no mem for pwd buffer, skip restore pwd!!\n");
-        goto try_setns;
+    struct nsproxy *ns, *stale = NULL;
+
+    mutex_lock(&ksu_init_ns_mutex);
+    if (unlikely(!ksu_init_task)) {
+        // &init_task is not init, but swapper/idle, which forks the init process
+        // so we need find init process
+        rcu_read_lock();
+        struct pid *pid_struct = find_pid_ns(1, &init_pid_ns);
+        if (pid_struct)
+            ksu_init_task = get_pid_task(pid_struct, PIDTYPE_PID);
+        rcu_read_unlock();
+        if (!ksu_init_task) {
+            mutex_unlock(&ksu_init_ns_mutex);
+            pr_warn("failed to get task_struct for PID 1\n");
+            return NULL;
+        }
     }
 
-    struct path saved_pwd;
-    get_fs_pwd(current->fs, &saved_pwd);
-    pwd_path = d_path(&saved_pwd, pwd_buf, PATH_MAX);
-    path_put(&saved_pwd);
+    task_lock(ksu_init_task);
+    ns = ksu_init_task->nsproxy;
+    if (unlikely(ns != ksu_init_nsproxy)) {
+        if (ns)
+            get_nsproxy(ns);
+        stale = ksu_init_nsproxy;
+        ksu_init_nsproxy = ns;
+    }
+    if (ns && ksu_init_task->fs) {
+        get_nsproxy(ns);
+        get_fs_root(ksu_init_task->fs, root);
+    } else {
+        ns = NULL;
+    }
+    task_unlock(ksu_init_task);
+    mutex_unlock(&ksu_init_ns_mutex);
 
-    if (IS_ERR(pwd_path)) {
-        if (PTR_ERR(pwd_path) == -ENAMETOOLONG) {
-            pr_warn("absolute pwd longer than: %d, skip restore pwd!!\n",
-                    PATH_MAX);
-        } else {
-            pr_warn("get absolute pwd failed: %ld\n", PTR_ERR(pwd_path));
-        }
-        pwd_path = NULL;
+    // dropping the last ref may sleep in put_mnt_ns
+    if (stale)
+        put_nsproxy(stale);
+
+    return ns;
+}
+
+bool ksu_nsproxy_only_mnt_differs(struct nsproxy *a, struct nsproxy *b)
+{
+    if (a->uts_ns != b->uts_ns || a->ipc_ns != b->ipc_ns ||
+        a->net_ns != b->net_ns)
+        return false;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 16, 0)
+    if (a->pid_ns_for_children != b->pid_ns_for_children)
+        return false;
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 6, 0)
+    if (a->cgroup_ns != b->cgroup_ns)
+        return false;
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+    if (a->time_ns != b->time_ns ||
+        a->time_ns_for_children != b->time_ns_for_children)
+        return false;
+#endif
+    return true;
+}
+
+/*
+ * Join init's mount namespace by sharing its nsproxy. This is what setns
+ * ends up with when all other namespaces are already the same as init's,
+ * which is the case for every app process on Android.
+ * Returns -EAGAIN when the task needs the full setns path, including when
+ * its creds would not pass the checks setns does: that path refuses them.
+ */
+static int ksu_switch_to_init_mnt_ns(void)
+{
+    struct path root;
+    struct nsproxy *ns;
+
+    // same capabilities as mntns_install, init's mnt ns is owned by
+    // init_user_ns; ns_capable also runs the LSM capable hooks
+    if (!ns_capable(&init_user_ns, CAP_SYS_ADMIN) ||
+        !ns_capable(current_user_ns(), CAP_SYS_CHROOT) ||
+        !ns_capable(current_user_ns(), CAP_SYS_ADMIN))
+        return -EAGAIN;
+
+    ns = ksu_get_init_nsproxy(&root);
+    if (!ns)
+        return -ESRCH;
+
+    if (current->nsproxy->mnt_ns == ns->mnt_ns) {
+        put_nsproxy(ns);
+        path_put(&root);
+        return 0;
     }
 
-try_setns:
+    // same restriction as mntns_install
+    if (current->fs->users != 1 ||
+        !ksu_nsproxy_only_mnt_differs(current->nsproxy, ns)) {
+        put_nsproxy(ns);
+        path_put(&root);
+        return -EAGAIN;
+    }
+
+    switch_task_namespaces(current, ns);
+    set_fs_root(current->fs, &root);
+    set_fs_pwd(current->fs, &root);
+    path_put(&root);
 
+    return 0;
+}
+
+void ksu_mount_ns_exit(void)
+{
+    mutex_lock(&ksu_init_ns_mutex);
+    if (ksu_init_nsproxy) {
+        put_nsproxy(ksu_init_nsproxy);
+        ksu_init_nsproxy = NULL;
+    }
+    if (ksu_init_task) {
+        put_task_struct(ksu_init_task);
+        ksu_init_task = NULL;
+    }
+    mutex_unlock(&ksu_init_ns_mutex);
+}
+
+static long ksu_setns_init_mnt_ns(void)
+{
     rcu_read_lock();
     // &init_task is not init, but swapper/idle, which forks the init process
     // so we need find init process
@@ -115,21 +227,21 @@ try_setns:
     if (unlikely(!pid_struct)) {
         rcu_read_unlock();
         pr_warn("failed to find pid_struct for PID 1\n");
-        goto out;
+        return -ESRCH;
     }
 
     struct task_struct *pid1_task = get_pid_task(pid_struct, PIDTYPE_PID);
     rcu_read_unlock();
     if (unlikely(!pid1_task)) {
         pr_warn("failed to get task_struct for PID 1\n");
-        goto out;
+        return -ESRCH;
     }
     struct path ns_path;
     long ret = (long)ns_get_path(&ns_path, pid1_task, &mntns_operations);
     put_task_struct(pid1_task);
     if (ret) {
         pr_warn("failed get path for init mount namespace: %ld\n", ret);
-        goto out;
+        return ret;
     }
     struct file *ns_file = dentry_open(&ns_path, O_RDONLY, ksu_cred);
 
@@ -137,14 +249,14 @@ try_setns:
     if (IS_ERR(ns_file)) {
         pr_warn("failed open file for init mount namespace: %ld\n",
                 PTR_ERR(ns_file));
-        goto out;
+        return PTR_ERR(ns_file);
     }
 
     int fd = get_unused_fd_flags(O_CLOEXEC);
     if (fd < 0) {
         pr_warn("failed to get an unused fd: %d\n", fd);
         fput(ns_file);
-        goto out;
+        return fd;
     }
 
     fd_install(fd, ns_file);
@@ -154,8 +266,51 @@ try_setns:
 
     if (ret) {
         pr_warn("call setns failed: %ld\n", ret);
-        goto out;
     }
+    return ret;
+}
+
+// global mode , need CAP_SYS_ADMIN and CAP_SYS_CHROOT to perform setns
+static void ksu_mnt_ns_global(void)
+{
+    char *pwd_path = NULL;
+    char *pwd_buf = NULL;
+    struct path saved_pwd, saved_root;
+    bool pwd_is_root;
+
+    get_fs_root(current->fs, &saved_root);
+    get_fs_pwd(current->fs, &saved_pwd);
+    pwd_is_root = path_equal(&saved_pwd, &saved_root);
+    path_put(&saved_root);
+
+    // save current working directory as absolute path before switching,
+    // "/" is the common case and maps to the new root without a lookup
+    if (!pwd_is_root) {
+        pwd_buf = __getname();
+        if (!pwd_buf) {
+            pr_warn("no mem for pwd buffer, skip restore pwd!!\n");
+        } else {
+            pwd_path = d_path(&saved_pwd, pwd_buf, PATH_MAX);
+            if (IS_ERR(pwd_path)) {
+                if (PTR_ERR(pwd_path) == -ENAMETOOLONG) {
+                    pr_warn("absolute pwd longer than: %d, skip restore pwd!!\n",
+                            PATH_MAX);
+                } else {
+                    pr_warn("get absolute pwd failed: %ld\n",
+                            PTR_ERR(pwd_path));
+                }
+                pwd_path = NULL;
+            }
+        }
+    }
+    path_put(&saved_pwd);
+
+    int ret = ksu_switch_to_init_mnt_ns();
+    if (ret == -EAGAIN)
+        ret = ksu_setns_init_mnt_ns();
+    if (ret)
+        goto out;
+
     // try to restore working directory using absolute path after setns
     if (pwd_path) {
         struct path new_pwd;
@@ -168,7 +323,8 @@ try_setns:
         }
     }
 out:
-    kfree(pwd_buf);
+    if (pwd_buf)
+        __putname(pwd_buf);
 }
 
 // individual mode , need CAP_SYS_ADMIN to perform unshare and remount
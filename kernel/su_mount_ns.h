@@ -1,10 +1,19 @@
 #ifndef __KSU_SU_MOUNT_NS_H
 #define __KSU_SU_MOUNT_NS_H
 
+#include <linux/types.h>
+
+struct nsproxy;
+
 #define KSU_NS_INHERITED 0
 #define KSU_NS_GLOBAL 1
 #define KSU_NS_INDIVIDUAL 2
 
 void setup_mount_ns(int32_t ns_mode);
 
+void ksu_mount_ns_exit(void);
+
+// true if both nsproxies share every namespace but (maybe) the mount one
+bool ksu_nsproxy_only_mnt_differs(struct nsproxy *a, struct nsproxy *b);
+
 #endif
\ No newline at end of file
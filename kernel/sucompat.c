@@ -30,7 +30,9 @@
 #include "ksud.h"
 #include "allowlist.h"
 #include "feature.h"
+#include "hook_stats.h"
 #include "klog.h" // IWYU pragma: keep
+#include "ksu_trace.h"
 #include "ksud.h"
 #include "sucompat.h"
 #include "app_profile.h"
@@ -101,10 +103,9 @@ extern bool ksu_kernel_umount_enabled;
 // WARNING!!!! THIS SHOULDN'T BE CALLED BY UNTRUSTED CONTEXT
 // IT IS DESIGNED ONLY FOR TRACEPOINT HOOK, BECAUSE CHECKS ALREADY COMPLETE WHEN TP REGISTER
 // ESPECIALLY DON'T CALL THAT IN MANUAL HOOK
-int ksu_handle_execve_sucompat_tp_internal(const char __user **filename_user,
-                                           void *__never_use_argv,
-                                           void *__never_use_envp,
-                                           int *__never_use_flags)
+static int __ksu_handle_execve_sucompat_tp_internal(
+    const char __user **filename_user, void *__never_use_argv,
+    void *__never_use_envp, int *__never_use_flags)
 {
     const char su[] = SU_PATH;
     const char __user *fn;
@@ -149,19 +150,34 @@ int ksu_handle_execve_sucompat_tp_internal(const char __user **filename_user,
     ksu_sulog_report_su_attempt(current_uid().val, NULL, su_path, true);
 #endif
 
-    pr_info("sys_execve su found\n");
+    trace_ksu_sucompat_redirect("execve");
     *filename_user = ksud_user_path();
 
     escape_with_root_profile();
 
     return 0;
 }
+
+int ksu_handle_execve_sucompat_tp_internal(const char __user **filename_user,
+                                           void *__never_use_argv,
+                                           void *__never_use_envp,
+                                           int *__never_use_flags)
+{
+    u64 start = ksu_hook_stats_start();
+    int ret = __ksu_handle_execve_sucompat_tp_internal(
+        filename_user, __never_use_argv, __never_use_envp, __never_use_flags);
+
+    ksu_hook_stats_end(KSU_HOOK_EXECVE_SU, start);
+    return ret;
+}
 #endif
 
 // the call from execve_handler_pre won't provided correct value for __never_use_argument, use them after fix execve_handler_pre, keeping them for consistence for manually patched code
-int ksu_handle_execveat_sucompat(int *fd, struct filename **filename_ptr,
-                                 void *__never_use_argv, void *__never_use_envp,
-                                 int *__never_use_flags)
+static int __ksu_handle_execveat_sucompat(int *fd,
+                                          struct filename **filename_ptr,
+                                          void *__never_use_argv,
+                                          void *__never_use_envp,
+                                          int *__never_use_flags)
 {
     struct filename *filename;
     bool is_allowed = ksu_is_allow_uid_for_current(current_uid().val);
@@ -189,7 +205,7 @@ int ksu_handle_execveat_sucompat(int *fd, struct filename **filename_ptr,
     ksu_sulog_report_su_attempt(current_uid().val, NULL, su_path, is_allowed);
 #endif
 
-    pr_info("do_execveat_common su found\n");
+    trace_ksu_sucompat_redirect("execve");
     memcpy((void *)filename->name, ksud_path, sizeof(ksud_path));
 
     escape_with_root_profile();
@@ -197,6 +213,19 @@ int ksu_handle_execveat_sucompat(int *fd, struct filename **filename_ptr,
     return 0;
 }
 
+int ksu_handle_execveat_sucompat(int *fd, struct filename **filename_ptr,
+                                 void *__never_use_argv, void *__never_use_envp,
+                                 int *__never_use_flags)
+{
+    u64 start = ksu_hook_stats_start();
+    int ret = __ksu_handle_execveat_sucompat(fd, filename_ptr, __never_use_argv,
+                                             __never_use_envp,
+                                             __never_use_flags);
+
+    ksu_hook_stats_end(KSU_HOOK_EXECVE_SU, start);
+    return ret;
+}
+
 #if defined(CONFIG_KSU_SUSFS) || defined(CONFIG_KSU_MANUAL_HOOK)
 static inline void ksu_handle_execveat_init(struct filename **filename_ptr)
 {
@@ -242,8 +271,8 @@ int ksu_handle_execveat(int *fd, struct filename **filename_ptr, void *argv,
 }
 #endif
 
-int ksu_handle_faccessat(int *dfd, const char __user **filename_user, int *mode,
-                         int *__unused_flags)
+static int __ksu_handle_faccessat(int *dfd, const char __user **filename_user,
+                                  int *mode, int *__unused_flags)
 {
     char path[sizeof(su_path) + 1] = { 0 };
 
@@ -260,15 +289,25 @@ int ksu_handle_faccessat(int *dfd, const char __user **filename_user, int *mode,
 #if __SULOG_GATE
         ksu_sulog_report_syscall(current_uid().val, NULL, "faccessat", path);
 #endif
-        pr_info("faccessat su->sh!\n");
+        trace_ksu_sucompat_redirect("faccessat");
         *filename_user = sh_user_path();
     }
 
     return 0;
 }
 
+int ksu_handle_faccessat(int *dfd, const char __user **filename_user, int *mode,
+                         int *__unused_flags)
+{
+    u64 start = ksu_hook_stats_start();
+    int ret = __ksu_handle_faccessat(dfd, filename_user, mode, __unused_flags);
+
+    ksu_hook_stats_end(KSU_HOOK_FACCESSAT, start);
+    return ret;
+}
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0) && defined(CONFIG_KSU_SUSFS)
-int ksu_handle_stat(int *dfd, struct filename **filename, int *flags)
+static int __ksu_handle_stat(int *dfd, struct filename **filename, int *flags)
 {
     if (!ksu_su_compat_enabled) {
         return 0;
@@ -289,12 +328,22 @@ int ksu_handle_stat(int *dfd, struct filename **filename, int *flags)
     ksu_sulog_report_syscall(current_uid().val, NULL, "newfstatat",
                              (*filename)->name);
 #endif
-    pr_info("ksu_handle_stat: su->sh!\n");
+    trace_ksu_sucompat_redirect("newfstatat");
     memcpy((void *)((*filename)->name), sh_path, sizeof(sh_path));
     return 0;
 }
+
+int ksu_handle_stat(int *dfd, struct filename **filename, int *flags)
+{
+    u64 start = ksu_hook_stats_start();
+    int ret = __ksu_handle_stat(dfd, filename, flags);
+
+    ksu_hook_stats_end(KSU_HOOK_STAT, start);
+    return ret;
+}
 #else
-int ksu_handle_stat(int *dfd, const char __user **filename_user, int *flags)
+static int __ksu_handle_stat(int *dfd, const char __user **filename_user,
+                             int *flags)
 {
     char path[sizeof(su_path) + 1] = { 0 };
 
@@ -315,12 +364,21 @@ int ksu_handle_stat(int *dfd, const char __user **filename_user, int *flags)
 #if __SULOG_GATE
         ksu_sulog_report_syscall(current_uid().val, NULL, "newfstatat", path);
 #endif
-        pr_info("ksu_handle_stat: su->sh!\n");
+        trace_ksu_sucompat_redirect("newfstatat");
         *filename_user = sh_user_path();
     }
 
     return 0;
 }
+
+int ksu_handle_stat(int *dfd, const char __user **filename_user, int *flags)
+{
+    u64 start = ksu_hook_stats_start();
+    int ret = __ksu_handle_stat(dfd, filename_user, flags);
+
+    ksu_hook_stats_end(KSU_HOOK_STAT, start);
+    return ret;
+}
 #endif // #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
 
 // dead code: devpts handling
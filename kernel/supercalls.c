@@ -5,12 +5,15 @@
 #include <linux/fdtable.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
 #include <linux/slab.h>
 #include <linux/kprobes.h>
 #include <linux/syscalls.h>
 #include <linux/task_work.h>
 #include <linux/uaccess.h>
 #include <linux/version.h>
+#include <linux/vmalloc.h>
 
 #ifdef CONFIG_KSU_SUSFS
 #include <linux/namei.h>
@@ -18,6 +21,8 @@
 #endif // #ifdef CONFIG_KSU_SUSFS
 
 #include "supercalls.h"
+#include "hook_stats.h"
+#include "ksu_trace.h"
 #include "arch.h"
 #include "allowlist.h"
 #include "feature.h"
@@ -145,12 +150,15 @@ static int do_report_event(void __user *arg)
 static int do_set_sepolicy(void __user *arg)
 {
     struct ksu_set_sepolicy_cmd cmd;
+    int ret;
 
     if (copy_from_user(&cmd, arg, sizeof(cmd))) {
         return -EFAULT;
     }
 
-    return handle_sepolicy(cmd.cmd, (void __user *)cmd.arg);
+    ret = handle_sepolicy(cmd.cmd, (void __user *)cmd.arg);
+    trace_ksu_sepolicy_apply(cmd.cmd, ret);
+    return ret;
 }
 
 static int do_check_safemode(void __user *arg)
@@ -357,6 +365,70 @@ static int do_set_feature(void __user *arg)
     return 0;
 }
 
+static struct ksu_feature_entry *
+copy_feature_entries(struct ksu_features_cmd *cmd, void __user *arg)
+{
+    if (copy_from_user(cmd, arg, sizeof(*cmd)))
+        return ERR_PTR(-EFAULT);
+
+    if (!cmd->count || cmd->count > KSU_FEATURES_MAX_COUNT)
+        return ERR_PTR(-EINVAL);
+
+    return memdup_user((const void __user *)cmd->arg,
+                       cmd->count * sizeof(struct ksu_feature_entry));
+}
+
+static int do_get_features(void __user *arg)
+{
+    struct ksu_features_cmd cmd;
+    struct ksu_feature_entry *entries;
+    bool supported;
+    u32 i;
+    int ret = 0;
+
+    entries = copy_feature_entries(&cmd, arg);
+    if (IS_ERR(entries))
+        return PTR_ERR(entries);
+
+    for (i = 0; i < cmd.count; i++) {
+        supported = false;
+        entries[i].result = ksu_get_feature(entries[i].feature_id,
+                                            &entries[i].value, &supported);
+        entries[i].supported = supported ? 1 : 0;
+    }
+
+    if (copy_to_user((void __user *)cmd.arg, entries,
+                     cmd.count * sizeof(*entries))) {
+        pr_err("get_features: copy_to_user failed\n");
+        ret = -EFAULT;
+    }
+
+    kfree(entries);
+    return ret;
+}
+
+static int do_set_features(void __user *arg)
+{
+    struct ksu_features_cmd cmd;
+    struct ksu_feature_entry *entries;
+    int ret = 0;
+
+    entries = copy_feature_entries(&cmd, arg);
+    if (IS_ERR(entries))
+        return PTR_ERR(entries);
+
+    ksu_set_features(entries, cmd.count);
+
+    if (copy_to_user((void __user *)cmd.arg, entries,
+                     cmd.count * sizeof(*entries))) {
+        pr_err("set_features: copy_to_user failed\n");
+        ret = -EFAULT;
+    }
+
+    kfree(entries);
+    return ret;
+}
+
 // kcompat for older kernel
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
 #define getfd_secure anon_inode_create_getfd
@@ -531,6 +603,7 @@ static int add_try_umount(void __user *arg)
             kfree(entry->umountable);
             kfree(entry);
         }
+        ksu_umount_plan_rebuild();
         up_write(&mount_list_lock);
 
         return 0;
@@ -576,6 +649,7 @@ static int add_try_umount(void __user *arg)
 
         // debug
         list_add(&new_entry->list, &mount_list);
+        ksu_umount_plan_rebuild();
         up_write(&mount_list_lock);
         pr_info("cmd_add_try_umount: %s added!\n", buf);
 
@@ -601,6 +675,7 @@ static int add_try_umount(void __user *arg)
                 kfree(entry);
             }
         }
+        ksu_umount_plan_rebuild();
         up_write(&mount_list_lock);
 
         return 0;
@@ -616,6 +691,175 @@ static int add_try_umount(void __user *arg)
     return 0;
 }
 
+static void free_mount_entries(struct list_head *head)
+{
+    struct mount_entry *entry, *tmp;
+
+    list_for_each_entry_safe (entry, tmp, head, list) {
+        list_del(&entry->list);
+        kfree(entry->umountable);
+        kfree(entry);
+    }
+}
+
+// 19. SET_TRY_UMOUNT_LIST - Replace the whole umount list in one call
+static int do_set_try_umount_list(void __user *arg)
+{
+    struct ksu_set_try_umount_list_cmd cmd;
+    DECLARE_HASHTABLE(seen, 6);
+    LIST_HEAD(new_list);
+    LIST_HEAD(old_list);
+    struct mount_entry *entry;
+    char *buf = NULL;
+    const char *pos, *end, *path;
+    u32 path_len, flags, hash, count = 0;
+    bool dup;
+    int ret = 0;
+
+    if (copy_from_user(&cmd, arg, sizeof(cmd)))
+        return -EFAULT;
+
+    if (cmd.buf_size > KSU_TRY_UMOUNT_LIST_MAX_SIZE)
+        return -E2BIG;
+
+    if (cmd.buf_size) {
+        buf = vmalloc(cmd.buf_size);
+        if (!buf)
+            return -ENOMEM;
+        if (copy_from_user(buf, (const void __user *)cmd.arg, cmd.buf_size)) {
+            ret = -EFAULT;
+            goto out;
+        }
+    }
+
+    hash_init(seen);
+    pos = buf;
+    end = buf + cmd.buf_size;
+    while (pos < end) {
+        if (end - pos < sizeof(u32)) {
+            ret = -EINVAL;
+            goto out;
+        }
+        memcpy(&path_len, pos, sizeof(u32));
+        pos += sizeof(u32);
+
+        // same limit as ADD_TRY_UMOUNT
+        if (!path_len || path_len >= 256 ||
+            end - pos < path_len + sizeof(u32)) {
+            ret = -EINVAL;
+            goto out;
+        }
+        path = pos;
+        pos += path_len;
+        memcpy(&flags, pos, sizeof(u32));
+        pos += sizeof(u32);
+
+        if (memchr(path, '\0', path_len)) {
+            ret = -EINVAL;
+            goto out;
+        }
+
+        // first one wins, like repeated ADD_TRY_UMOUNT calls
+        hash = jhash(path, path_len, 0);
+        dup = false;
+        hash_for_each_possible (seen, entry, hnode, hash) {
+            if (!strncmp(entry->umountable, path, path_len) &&
+                !entry->umountable[path_len]) {
+                dup = true;
+                break;
+            }
+        }
+        if (dup)
+            continue;
+
+        entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+        if (!entry) {
+            ret = -ENOMEM;
+            goto out;
+        }
+        entry->umountable = kmalloc(path_len + 1, GFP_KERNEL);
+        if (!entry->umountable) {
+            kfree(entry);
+            ret = -ENOMEM;
+            goto out;
+        }
+        memcpy(entry->umountable, path, path_len);
+        entry->umountable[path_len] = '\0';
+        entry->flags = flags;
+
+        // keep the order repeated list_add would have produced
+        list_add(&entry->list, &new_list);
+        hash_add(seen, &entry->hnode, hash);
+        count++;
+    }
+
+    down_write(&mount_list_lock);
+    list_splice_init(&mount_list, &old_list);
+    list_splice_init(&new_list, &mount_list);
+    ksu_umount_plan_rebuild();
+    up_write(&mount_list_lock);
+
+    free_mount_entries(&old_list);
+    pr_info("set_try_umount_list: %u entries loaded\n", count);
+
+    cmd.count = count;
+    if (copy_to_user(arg, &cmd, sizeof(cmd)))
+        ret = -EFAULT;
+
+out:
+    free_mount_entries(&new_list);
+    vfree(buf);
+    return ret;
+}
+
+// 255. LIST_TRY_UMOUNT - Dump the umount list as text
+static int do_list_try_umount(void __user *arg)
+{
+    static const char header[] = "Mount Point\tFlags\n"
+                                 "-----------\t-----\n";
+    struct ksu_list_try_umount_cmd cmd;
+    struct mount_entry *entry;
+    size_t size = sizeof(header);
+    size_t len;
+    char *buf;
+    int ret = 0;
+
+    if (copy_from_user(&cmd, arg, sizeof(cmd)))
+        return -EFAULT;
+
+    down_read(&mount_list_lock);
+    list_for_each_entry (entry, &mount_list, list) {
+        // tab, up to 10 digits of flags and newline
+        size += strlen(entry->umountable) + 12;
+    }
+
+    buf = vmalloc(size);
+    if (!buf) {
+        up_read(&mount_list_lock);
+        return -ENOMEM;
+    }
+
+    len = scnprintf(buf, size, "%s", header);
+    list_for_each_entry (entry, &mount_list, list) {
+        len += scnprintf(buf + len, size - len, "%s\t%u\n", entry->umountable,
+                         entry->flags);
+    }
+    up_read(&mount_list_lock);
+
+    if (len + 1 > cmd.buf_size) {
+        cmd.buf_size = len + 1;
+        ret = copy_to_user(arg, &cmd, sizeof(cmd)) ? -EFAULT : -ENOSPC;
+        goto out;
+    }
+
+    if (copy_to_user((void __user *)cmd.arg, buf, len + 1))
+        ret = -EFAULT;
+
+out:
+    vfree(buf);
+    return ret;
+}
+
 // 100. GET_FULL_VERSION - Get full version string
 static int do_get_full_version(void __user *arg)
 {
@@ -722,6 +966,8 @@ static int do_get_managers(void __user *arg)
 }
 
 // IOCTL handlers mapping table
+static int do_get_stats(void __user *arg);
+
 static const struct ksu_ioctl_cmd_map ksu_ioctl_handlers[] = {
     { .cmd = KSU_IOCTL_GRANT_ROOT,
       .name = "GRANT_ROOT",
@@ -779,6 +1025,14 @@ static const struct ksu_ioctl_cmd_map ksu_ioctl_handlers[] = {
       .name = "SET_FEATURE",
       .handler = do_set_feature,
       .perm_check = manager_or_root },
+    { .cmd = KSU_IOCTL_GET_FEATURES,
+      .name = "GET_FEATURES",
+      .handler = do_get_features,
+      .perm_check = manager_or_root },
+    { .cmd = KSU_IOCTL_SET_FEATURES,
+      .name = "SET_FEATURES",
+      .handler = do_set_features,
+      .perm_check = manager_or_root },
     { .cmd = KSU_IOCTL_GET_WRAPPER_FD,
       .name = "GET_WRAPPER_FD",
       .handler = do_get_wrapper_fd,
@@ -795,6 +1049,18 @@ static const struct ksu_ioctl_cmd_map ksu_ioctl_handlers[] = {
       .name = "ADD_TRY_UMOUNT",
       .handler = add_try_umount,
       .perm_check = manager_or_root },
+    { .cmd = KSU_IOCTL_SET_TRY_UMOUNT_LIST,
+      .name = "SET_TRY_UMOUNT_LIST",
+      .handler = do_set_try_umount_list,
+      .perm_check = manager_or_root },
+    { .cmd = KSU_IOCTL_GET_STATS,
+      .name = "GET_STATS",
+      .handler = do_get_stats,
+      .perm_check = manager_or_root },
+    { .cmd = KSU_IOCTL_LIST_TRY_UMOUNT,
+      .name = "LIST_TRY_UMOUNT",
+      .handler = do_list_try_umount,
+      .perm_check = manager_or_root },
     { .cmd = KSU_IOCTL_GET_FULL_VERSION,
       .name = "GET_FULL_VERSION",
       .handler = do_get_full_version,
@@ -834,6 +1100,41 @@ static const struct ksu_ioctl_cmd_map ksu_ioctl_handlers[] = {
     { .cmd = 0, .name = NULL, .handler = NULL, .perm_check = NULL } // Sentine
 };
 
+// Fixed hooks first, then one entry per ioctl in table order
+static int do_get_stats(void __user *arg)
+{
+    struct ksu_get_stats_cmd cmd;
+    struct ksu_hook_stats_entry entry;
+    struct ksu_hook_stats_entry __user *out;
+    u32 total = KSU_HOOK_IOCTL_BASE + ARRAY_SIZE(ksu_ioctl_handlers) - 1;
+    const char *name;
+    u32 i;
+
+    if (copy_from_user(&cmd, arg, sizeof(cmd))) {
+        pr_err("get_stats: copy_from_user failed\n");
+        return -EFAULT;
+    }
+
+    out = (struct ksu_hook_stats_entry __user *)cmd.arg;
+    for (i = 0; out && i < min(cmd.count, total); i++) {
+        name = i < KSU_HOOK_IOCTL_BASE ?
+                   NULL :
+                   ksu_ioctl_handlers[i - KSU_HOOK_IOCTL_BASE].name;
+        ksu_hook_stats_read(i, name, &entry, cmd.flags & KSU_STATS_RESET);
+        if (copy_to_user(&out[i], &entry, sizeof(entry))) {
+            pr_err("get_stats: copy_to_user failed\n");
+            return -EFAULT;
+        }
+    }
+
+    cmd.count = total;
+    if (copy_to_user(arg, &cmd, sizeof(cmd))) {
+        pr_err("get_stats: copy_to_user failed\n");
+        return -EFAULT;
+    }
+    return 0;
+}
+
 struct ksu_install_fd_tw {
     struct callback_head cb;
     int __user *outp;
@@ -1003,6 +1304,8 @@ void ksu_supercalls_init(void)
 {
     int i;
 
+    BUILD_BUG_ON(ARRAY_SIZE(ksu_ioctl_handlers) - 1 > KSU_HOOK_MAX_IOCTLS);
+
     pr_info("KernelSU IOCTL Commands:\n");
     for (i = 0; ksu_ioctl_handlers[i].handler; i++) {
         pr_info("  %-18s = 0x%08x\n", ksu_ioctl_handlers[i].name,
@@ -1059,7 +1362,9 @@ static long anon_ksu_ioctl(struct file *filp, unsigned int cmd,
                 return -EPERM;
             }
             // Execute handler
+            u64 start = ksu_hook_stats_start();
             int ret = ksu_ioctl_handlers[i].handler(argp);
+            ksu_hook_stats_end(KSU_HOOK_IOCTL_BASE + i, start);
             ksu_ioctl_audit(cmd, ksu_ioctl_handlers[i].name, current_uid().val,
                             ret);
             return ret;
@@ -78,6 +78,41 @@ struct ksu_set_feature_cmd {
     __u64 value; // Input: feature value/state to set
 };
 
+// Batch form of GET_FEATURE / SET_FEATURE
+struct ksu_feature_entry {
+    __u32 feature_id; // Input: feature ID (enum ksu_feature_id)
+    __u32 supported; // Output: true if feature is supported, false otherwise
+    __u64 value; // Input (set) / Output (get): feature value/state
+    __s32 result; // Output: 0 or -errno for this entry
+    __u32 reserved;
+};
+
+#define KSU_FEATURES_MAX_COUNT 64
+
+struct ksu_features_cmd {
+    __aligned_u64 arg; // Input: pointer to struct ksu_feature_entry array
+    __u32 count; // Input: number of entries
+};
+
+#define KSU_STATS_NAME_LEN 32
+#define KSU_STATS_BUCKETS 32
+#define KSU_STATS_RESET (1 << 0)
+
+struct ksu_hook_stats_entry {
+    char name[KSU_STATS_NAME_LEN]; // Output: hook name, or ioctl name
+    __u64 count; // Output: number of calls
+    __u64 total_ns; // Output: total time spent
+    // Output: hist[i] counts calls of [2^i, 2^(i+1)) ns
+    __u64 hist[KSU_STATS_BUCKETS];
+};
+
+struct ksu_get_stats_cmd {
+    // Input: pointer to struct ksu_hook_stats_entry array, may be 0
+    __aligned_u64 arg;
+    __u32 count; // Input: array capacity, Output: number of entries available
+    __u32 flags; // Input: KSU_STATS_RESET clears the counters once read
+};
+
 struct ksu_get_wrapper_fd_cmd {
     __u32 fd; // Input: userspace fd
     __u32 flags; // Input: flags of userspace fd
@@ -108,6 +143,21 @@ struct ksu_add_try_umount_cmd {
 #define KSU_UMOUNT_ADD 1 // add entry (path + flags)
 #define KSU_UMOUNT_DEL 2 // delete entry, strcmp
 
+// Packed records, same layout as ksud's umount config file:
+// __u32 path_len, char path[path_len] (no NUL), __u32 flags
+struct ksu_set_try_umount_list_cmd {
+    __aligned_u64 arg; // Input: pointer to the packed records
+    __u32 buf_size; // Input: size of the record buffer
+    __u32 count; // Output: number of entries in the new list
+};
+
+#define KSU_TRY_UMOUNT_LIST_MAX_SIZE (64 * 1024)
+
+struct ksu_list_try_umount_cmd {
+    __aligned_u64 arg; // Input: user buffer for the text listing
+    __u32 buf_size; // Input: buffer size / Output: size needed on -ENOSPC
+};
+
 // Other command structures
 struct ksu_get_full_version_cmd {
     char version_full[KSU_FULL_VERSION_STRING]; // Output: full version string
@@ -121,9 +171,11 @@ struct ksu_enable_kpm_cmd {
     __u8 enabled; // Output: true if KPM is enabled
 };
 
-#define DYNAMIC_MANAGER_OP_SET 0
-#define DYNAMIC_MANAGER_OP_GET 1
-#define DYNAMIC_MANAGER_OP_WIPE 2
+#define DYNAMIC_MANAGER_OP_SET 0 // replace every key with this one
+#define DYNAMIC_MANAGER_OP_GET 1 // the most recently set key
+#define DYNAMIC_MANAGER_OP_WIPE 2 // drop every key
+#define DYNAMIC_MANAGER_OP_ADD 3 // add a key, drops the oldest when full
+#define DYNAMIC_MANAGER_OP_REMOVE 4 // drop this key only
 struct ksu_dynamic_manager_cmd {
     unsigned int operation;
     unsigned int size;
@@ -160,6 +212,11 @@ struct ksu_get_managers_cmd {
 #define KSU_IOCTL_MANAGE_MARK _IOC(_IOC_READ | _IOC_WRITE, 'K', 16, 0)
 #define KSU_IOCTL_NUKE_EXT4_SYSFS _IOC(_IOC_WRITE, 'K', 17, 0)
 #define KSU_IOCTL_ADD_TRY_UMOUNT _IOC(_IOC_WRITE, 'K', 18, 0)
+#define KSU_IOCTL_SET_TRY_UMOUNT_LIST _IOC(_IOC_READ | _IOC_WRITE, 'K', 19, 0)
+#define KSU_IOCTL_GET_FEATURES _IOC(_IOC_READ | _IOC_WRITE, 'K', 20, 0)
+#define KSU_IOCTL_SET_FEATURES _IOC(_IOC_READ | _IOC_WRITE, 'K', 21, 0)
+#define KSU_IOCTL_GET_STATS _IOC(_IOC_READ | _IOC_WRITE, 'K', 22, 0)
+#define KSU_IOCTL_LIST_TRY_UMOUNT _IOC(_IOC_READ | _IOC_WRITE, 'K', 255, 0)
 
 // Other IOCTL command definitions
 #define KSU_IOCTL_GET_FULL_VERSION _IOC(_IOC_READ, 'K', 100, 0)
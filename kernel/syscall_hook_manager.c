@@ -14,6 +14,7 @@
 #include "allowlist.h"
 #include "arch.h"
 #include "klog.h" // IWYU pragma: keep
+#include "ksu_trace.h"
 #include "syscall_hook_manager.h"
 #include "sucompat.h"
 #include "setuid_hook.h"
@@ -81,12 +82,10 @@ static void ksu_mark_running_process_locked()
         if (ksu_root_process || is_zygote_process || is_shell || is_init ||
             ksu_is_allow_uid(uid)) {
             ksu_set_task_tracepoint_flag(t);
-            pr_info("hook_manager: mark process: pid:%d, uid: %d, comm:%s\n",
-                    t->pid, uid, t->comm);
+            trace_ksu_mark_process(t, true);
         } else {
             ksu_clear_task_tracepoint_flag(t);
-            pr_info("hook_manager: unmark process: pid:%d, uid: %d, comm:%s\n",
-                    t->pid, uid, t->comm);
+            trace_ksu_mark_process(t, false);
         }
         put_cred(cred);
     }
@@ -145,13 +144,10 @@ int ksu_set_task_mark(pid_t pid, bool mark)
         rcu_read_unlock();
         if (mark) {
             ksu_set_task_tracepoint_flag(task);
-            pr_info("hook_manager: marked task pid=%d comm=%s\n", pid,
-                    task->comm);
         } else {
             ksu_clear_task_tracepoint_flag(task);
-            pr_info("hook_manager: unmarked task pid=%d comm=%s\n", pid,
-                    task->comm);
         }
+        trace_ksu_mark_process(task, mark);
         put_task_struct(task);
         ret = 0;
     } else {
@@ -277,8 +273,8 @@ int ksu_handle_init_mark_tracker(const char __user **filename_user)
         escape_to_root_for_init();
     } else if (likely(strstr(path, "/app_process") == NULL &&
                       strstr(path, "/adbd") == NULL)) {
-        pr_info("hook_manager: unmark %d exec %s\n", current->pid, path);
         ksu_clear_task_tracepoint_flag_if_needed(current);
+        trace_ksu_mark_process(current, false);
     }
 
     return 0;
@@ -11,6 +11,8 @@
 
 #include "allowlist.h"
 #include "apk_sign.h"
+#include "hook_stats.h"
+#include "ksu_trace.h"
 #include "klog.h" // IWYU pragma: keep
 #include "manager.h"
 #include "throne_tracker.h"
@@ -46,6 +48,7 @@ static void crown_manager(const char *apk, struct list_head *uid_data,
         if (strncmp(np->package, pkg, KSU_MAX_PACKAGE_NAME) == 0) {
             pr_info("Crowning manager: %s uid=%d, signature_index=%d\n", pkg,
                     np->uid, signature_index);
+            trace_ksu_manager_crowned(pkg, np->uid, signature_index);
 
             ksu_register_manager(np->uid, signature_index);
             break;
@@ -264,7 +267,7 @@ static bool is_uid_exist(uid_t uid, char *package, void *data)
     return exist;
 }
 
-void track_throne(bool prune_only, bool force_search_manager)
+static void __track_throne(bool prune_only, bool force_search_manager)
 {
     struct list_head uid_list;
     struct uid_data *np, *n;
@@ -413,6 +416,14 @@ out:
         ksu_bitmap_free(diff_map);
 }
 
+void track_throne(bool prune_only, bool force_search_manager)
+{
+    u64 start = ksu_hook_stats_start();
+
+    __track_throne(prune_only, force_search_manager);
+    ksu_hook_stats_end(KSU_HOOK_TRACK_THRONE, start);
+}
+
 void ksu_throne_tracker_init(void)
 {
     // nothing to do
@@ -0,0 +1,363 @@
+#include <linux/atomic.h>
+#include <linux/cred.h>
+#include <linux/err.h>
+#include <linux/fs_struct.h>
+#include <linux/kthread.h>
+#include <linux/mutex.h>
+#include <linux/nsproxy.h>
+#include <linux/path.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/version.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+#include <linux/sched/task.h>
+#endif
+
+#include "feature.h"
+#include "kernel_umount.h"
+#include "klog.h" // IWYU pragma: keep
+#include "ksu.h"
+#include "su_mount_ns.h"
+#include "umount_ns.h"
+
+/*
+ * Instead of walking the umount list in every forked app, cut a copy of the
+ * zygote mount namespace once per module-mount generation, umount the module
+ * mounts in it, and let qualifying apps switch to a private copy of that.
+ *
+ * Only processes still sharing the mount namespace of their zygote qualify:
+ * zygote already gave the others their own namespace with per-app mounts
+ * (emulated storage, data isolation) which must not be thrown away.
+ */
+
+static bool ksu_clean_mnt_ns_enabled = false;
+
+static atomic_t umount_ns_generation = ATOMIC_INIT(0);
+static atomic_t umount_ns_building = ATOMIC_INIT(0);
+
+// last builder started, exit stops it before dropping the slots
+static DEFINE_MUTEX(umount_ns_builder_lock);
+static struct task_struct *umount_ns_builder;
+static struct umount_ns_build *umount_ns_builder_data;
+static bool umount_ns_stopped;
+
+// one template per source zygote namespace (zygote, zygote64, app zygotes)
+#define UMOUNT_NS_SLOTS 4
+
+struct umount_ns_slot {
+    struct nsproxy *source; // namespaces the template was cut from
+    struct nsproxy *tmpl;
+    struct path root;
+    int generation;
+};
+
+static struct umount_ns_slot umount_ns_slots[UMOUNT_NS_SLOTS];
+static unsigned int umount_ns_next_slot;
+static DEFINE_SPINLOCK(umount_ns_lock);
+
+struct umount_ns_build {
+    struct nsproxy *source;
+    struct path root;
+    int generation;
+};
+
+static void umount_ns_build_free(struct umount_ns_build *build)
+{
+    if (build->source)
+        put_nsproxy(build->source);
+    path_put(&build->root);
+    kfree(build);
+}
+
+static void umount_ns_slot_release(struct umount_ns_slot *slot)
+{
+    if (slot->tmpl)
+        put_nsproxy(slot->tmpl);
+    if (slot->source)
+        put_nsproxy(slot->source);
+    if (slot->root.mnt)
+        path_put(&slot->root);
+    memset(slot, 0, sizeof(*slot));
+}
+
+static void umount_ns_drop_all(void)
+{
+    struct umount_ns_slot old[UMOUNT_NS_SLOTS];
+    int i;
+
+    spin_lock(&umount_ns_lock);
+    memcpy(old, umount_ns_slots, sizeof(old));
+    memset(umount_ns_slots, 0, sizeof(umount_ns_slots));
+    spin_unlock(&umount_ns_lock);
+
+    // put_nsproxy may sleep, never under the spinlock
+    for (i = 0; i < UMOUNT_NS_SLOTS; i++)
+        umount_ns_slot_release(&old[i]);
+}
+
+void ksu_umount_ns_invalidate(void)
+{
+    atomic_inc(&umount_ns_generation);
+    ksu_umount_forget_cleaned_ns();
+}
+
+static int umount_ns_build_fn(void *data)
+{
+    struct umount_ns_build *build = data;
+    struct umount_ns_slot slot = { 0 };
+    struct umount_ns_slot old = { 0 };
+    struct nsproxy *new_ns = NULL;
+    const struct cred *saved;
+    int i, err;
+
+    // kthreads share init_task's fs_struct, get our own before switching
+    err = unshare_fs_struct();
+    if (err) {
+        pr_err("umount_ns: unshare fs failed: %d\n", err);
+        goto out;
+    }
+
+    get_nsproxy(build->source);
+    switch_task_namespaces(current, build->source);
+    set_fs_root(current->fs, &build->root);
+    set_fs_pwd(current->fs, &build->root);
+
+    saved = override_creds(ksu_cred);
+    err = unshare_nsproxy_namespaces(CLONE_NEWNS, &new_ns, NULL, current->fs);
+    if (err || !new_ns) {
+        revert_creds(saved);
+        pr_err("umount_ns: copy mount namespace failed: %d\n", err);
+        goto out;
+    }
+    switch_task_namespaces(current, new_ns);
+
+    ksu_umount_all();
+    revert_creds(saved);
+
+    slot.source = build->source;
+    build->source = NULL;
+    get_nsproxy(current->nsproxy);
+    slot.tmpl = current->nsproxy;
+    get_fs_root(current->fs, &slot.root);
+    slot.generation = build->generation;
+
+    spin_lock(&umount_ns_lock);
+    for (i = 0; i < UMOUNT_NS_SLOTS; i++) {
+        if (umount_ns_slots[i].source &&
+            umount_ns_slots[i].source->mnt_ns == slot.source->mnt_ns)
+            break;
+    }
+    if (i == UMOUNT_NS_SLOTS)
+        i = umount_ns_next_slot++ % UMOUNT_NS_SLOTS;
+    old = umount_ns_slots[i];
+    umount_ns_slots[i] = slot;
+    spin_unlock(&umount_ns_lock);
+
+    umount_ns_slot_release(&old);
+    pr_info("umount_ns: template ready, generation: %d\n", slot.generation);
+
+out:
+    umount_ns_build_free(build);
+    atomic_set(&umount_ns_building, 0);
+    return 0;
+}
+
+static void umount_ns_schedule_build(struct nsproxy *source, struct path *root,
+                                     int generation)
+{
+    struct umount_ns_build *build;
+    struct task_struct *tsk;
+
+    if (atomic_cmpxchg(&umount_ns_building, 0, 1))
+        return;
+
+    mutex_lock(&umount_ns_builder_lock);
+    if (umount_ns_stopped)
+        goto idle;
+
+    build = kzalloc(sizeof(*build), GFP_KERNEL);
+    if (!build)
+        goto idle;
+
+    get_nsproxy(source);
+    build->source = source;
+    build->root = *root;
+    path_get(&build->root);
+    build->generation = generation;
+
+    tsk = kthread_create(umount_ns_build_fn, build, "ksu_umount_ns");
+    if (IS_ERR(tsk)) {
+        pr_err("umount_ns: start builder failed: %ld\n", PTR_ERR(tsk));
+        umount_ns_build_free(build);
+        goto idle;
+    }
+
+    // the previous builder is done, building was 0
+    if (umount_ns_builder)
+        put_task_struct(umount_ns_builder);
+    get_task_struct(tsk);
+    umount_ns_builder = tsk;
+    umount_ns_builder_data = build;
+    wake_up_process(tsk);
+    mutex_unlock(&umount_ns_builder_lock);
+    return;
+
+idle:
+    mutex_unlock(&umount_ns_builder_lock);
+    atomic_set(&umount_ns_building, 0);
+}
+
+static void umount_ns_stop_builder(void)
+{
+    struct umount_ns_build *build;
+    struct task_struct *tsk;
+
+    mutex_lock(&umount_ns_builder_lock);
+    umount_ns_stopped = true;
+    tsk = umount_ns_builder;
+    build = umount_ns_builder_data;
+    umount_ns_builder = NULL;
+    umount_ns_builder_data = NULL;
+    mutex_unlock(&umount_ns_builder_lock);
+
+    if (!tsk)
+        return;
+
+    // waits for a running builder, -EINTR means it never got to run
+    if (kthread_stop(tsk) == -EINTR)
+        umount_ns_build_free(build);
+    put_task_struct(tsk);
+}
+
+bool ksu_umount_ns_try_switch(void)
+{
+    struct task_struct *parent;
+    struct nsproxy *parent_ns = NULL;
+    struct nsproxy *tmpl = NULL;
+    struct nsproxy *new_ns = NULL;
+    struct path parent_root;
+    struct path root;
+    int generation, i, err;
+    bool switched = false;
+
+    if (!ksu_clean_mnt_ns_enabled)
+        return false;
+
+    if (current->fs->users != 1)
+        return false;
+
+    rcu_read_lock();
+    parent = rcu_dereference(current->real_parent);
+    get_task_struct(parent);
+    rcu_read_unlock();
+
+    task_lock(parent);
+    if (parent->nsproxy && parent->fs) {
+        parent_ns = parent->nsproxy;
+        get_nsproxy(parent_ns);
+        get_fs_root(parent->fs, &parent_root);
+    }
+    task_unlock(parent);
+    put_task_struct(parent);
+
+    if (!parent_ns)
+        return false;
+
+    // zygote already gave this app its own namespace, keep its mounts
+    if (current->nsproxy->mnt_ns != parent_ns->mnt_ns)
+        goto out;
+
+    generation = atomic_read(&umount_ns_generation);
+
+    spin_lock(&umount_ns_lock);
+    for (i = 0; i < UMOUNT_NS_SLOTS; i++) {
+        struct umount_ns_slot *slot = &umount_ns_slots[i];
+        if (slot->tmpl && slot->source->mnt_ns == parent_ns->mnt_ns &&
+            slot->generation == generation) {
+            tmpl = slot->tmpl;
+            get_nsproxy(tmpl);
+            root = slot->root;
+            path_get(&root);
+            break;
+        }
+    }
+    spin_unlock(&umount_ns_lock);
+
+    if (!tmpl) {
+        // this one walks the list, the next fork gets the template
+        umount_ns_schedule_build(parent_ns, &parent_root, generation);
+        goto out;
+    }
+
+    if (!ksu_nsproxy_only_mnt_differs(current->nsproxy, tmpl)) {
+        put_nsproxy(tmpl);
+        path_put(&root);
+        goto out;
+    }
+
+    switch_task_namespaces(current, tmpl);
+    set_fs_root(current->fs, &root);
+    set_fs_pwd(current->fs, &root);
+    path_put(&root);
+
+    // private copy, so nothing done by this process leaks into the template
+    err = unshare_nsproxy_namespaces(CLONE_NEWNS, &new_ns, NULL, current->fs);
+    if (!err && new_ns) {
+        switch_task_namespaces(current, new_ns);
+        switched = true;
+    } else {
+        // never share the template, back to zygote's and the normal plan
+        pr_warn("umount_ns: copy template failed: %d\n", err);
+        get_nsproxy(parent_ns);
+        switch_task_namespaces(current, parent_ns);
+        set_fs_root(current->fs, &parent_root);
+        set_fs_pwd(current->fs, &parent_root);
+    }
+
+out:
+    put_nsproxy(parent_ns);
+    path_put(&parent_root);
+    return switched;
+}
+
+static int clean_mnt_ns_feature_get(u64 *value)
+{
+    *value = ksu_clean_mnt_ns_enabled ? 1 : 0;
+    return 0;
+}
+
+static int clean_mnt_ns_feature_set(u64 value)
+{
+    bool enable = value != 0;
+    ksu_clean_mnt_ns_enabled = enable;
+    if (!enable)
+        umount_ns_drop_all();
+    pr_info("clean_mnt_ns: set to %d\n", enable);
+    return 0;
+}
+
+static const struct ksu_feature_handler clean_mnt_ns_handler = {
+    .feature_id = KSU_FEATURE_CLEAN_MNT_NS,
+    .name = "clean_mnt_ns",
+    .get_handler = clean_mnt_ns_feature_get,
+    .set_handler = clean_mnt_ns_feature_set,
+};
+
+void ksu_umount_ns_init(void)
+{
+    if (ksu_register_feature_handler(&clean_mnt_ns_handler)) {
+        pr_err("Failed to register clean_mnt_ns feature handler\n");
+    }
+}
+
+void ksu_umount_ns_exit(void)
+{
+    ksu_unregister_feature_handler(KSU_FEATURE_CLEAN_MNT_NS);
+    ksu_clean_mnt_ns_enabled = false;
+    // a running builder could refill a slot after the drop
+    umount_ns_stop_builder();
+    umount_ns_drop_all();
+}
@@ -0,0 +1,20 @@
+#ifndef __KSU_H_UMOUNT_NS
+#define __KSU_H_UMOUNT_NS
+
+#include <linux/types.h>
+
+void ksu_umount_ns_init(void);
+void ksu_umount_ns_exit(void);
+
+// Must be bumped whenever the umount list or the module mounts change
+void ksu_umount_ns_invalidate(void);
+
+/*
+ * Switch current into a private copy of a pre-cleaned mount namespace.
+ * Called from the umount task_work, with ksu_cred overridden.
+ * Returns false when current doesn't qualify and the caller should walk
+ * the umount list itself.
+ */
+bool ksu_umount_ns_try_switch(void);
+
+#endif
@@ -8,6 +8,119 @@
 #include <linux/capability.h>
 #include <pwd.h>
 
+#define NATIVES_CLASS "com/vortexsu/vortexsu/Natives"
+
+// Classes, fields and methods the bridges use, resolved once in JNI_OnLoad
+static struct {
+	struct {
+		jclass cls;
+		jmethodID init;
+		jfieldID name, currentUid, allowSu;
+		jfieldID rootUseDefault, rootTemplate, uid, gid, groups, capabilities, context, namespace;
+		jfieldID nonRootUseDefault, umountModules;
+	} profile;
+	struct {
+		jclass cls;
+		jmethodID intList, toIntArray;
+	} natives;
+	struct {
+		jclass cls;
+		jmethodID init;
+		jfieldID size, hash;
+	} dynamicManagerConfig;
+	struct {
+		jclass cls;
+		jmethodID init;
+		jfieldID count, managers;
+	} managersList;
+	struct {
+		jclass cls;
+		jmethodID init;
+	} managerInfo;
+	struct {
+		jclass cls;
+		jmethodID init, add;
+	} arrayList;
+} ids;
+
+static jclass findGlobalClass(JNIEnv *env, const char *name) {
+	jclass local = GetEnvironment()->FindClass(env, name);
+	if (!local) {
+		return NULL;
+	}
+	jclass global = GetEnvironment()->NewGlobalRef(env, local);
+	GetEnvironment()->DeleteLocalRef(env, local);
+	return global;
+}
+
+// bail out on the first missing id, its exception is left pending
+#define RESOLVE(target, lookup) do { \
+	if (!((target) = (lookup))) \
+		return false; \
+} while (0)
+
+#define RESOLVE_FIELD(group, field, signature) \
+	RESOLVE(ids.group.field, GetEnvironment()->GetFieldID(env, ids.group.cls, #field, signature))
+
+static bool resolveIds(JNIEnv *env) {
+	RESOLVE(ids.profile.cls, findGlobalClass(env, NATIVES_CLASS "$Profile"));
+	RESOLVE(ids.profile.init, GetEnvironment()->GetMethodID(env, ids.profile.cls, "<init>", "()V"));
+	RESOLVE_FIELD(profile, name, "Ljava/lang/String;");
+	RESOLVE_FIELD(profile, currentUid, "I");
+	RESOLVE_FIELD(profile, allowSu, "Z");
+	RESOLVE_FIELD(profile, rootUseDefault, "Z");
+	RESOLVE_FIELD(profile, rootTemplate, "Ljava/lang/String;");
+	RESOLVE_FIELD(profile, uid, "I");
+	RESOLVE_FIELD(profile, gid, "I");
+	RESOLVE_FIELD(profile, groups, "Ljava/util/List;");
+	RESOLVE_FIELD(profile, capabilities, "Ljava/util/List;");
+	RESOLVE_FIELD(profile, context, "Ljava/lang/String;");
+	RESOLVE_FIELD(profile, namespace, "I");
+	RESOLVE_FIELD(profile, nonRootUseDefault, "Z");
+	RESOLVE_FIELD(profile, umountModules, "Z");
+
+	RESOLVE(ids.natives.cls, findGlobalClass(env, NATIVES_CLASS));
+	RESOLVE(ids.natives.intList, GetEnvironment()->GetStaticMethodID(env, ids.natives.cls,
+			"intList", "([I)Ljava/util/List;"));
+	RESOLVE(ids.natives.toIntArray, GetEnvironment()->GetStaticMethodID(env, ids.natives.cls,
+			"toIntArray", "(Ljava/util/List;)[I"));
+
+	RESOLVE(ids.dynamicManagerConfig.cls, findGlobalClass(env, NATIVES_CLASS "$DynamicManagerConfig"));
+	RESOLVE(ids.dynamicManagerConfig.init,
+			GetEnvironment()->GetMethodID(env, ids.dynamicManagerConfig.cls, "<init>", "()V"));
+	RESOLVE_FIELD(dynamicManagerConfig, size, "I");
+	RESOLVE_FIELD(dynamicManagerConfig, hash, "Ljava/lang/String;");
+
+	RESOLVE(ids.managersList.cls, findGlobalClass(env, NATIVES_CLASS "$ManagersList"));
+	RESOLVE(ids.managersList.init, GetEnvironment()->GetMethodID(env, ids.managersList.cls, "<init>", "()V"));
+	RESOLVE_FIELD(managersList, count, "I");
+	RESOLVE_FIELD(managersList, managers, "Ljava/util/List;");
+
+	RESOLVE(ids.managerInfo.cls, findGlobalClass(env, NATIVES_CLASS "$ManagerInfo"));
+	RESOLVE(ids.managerInfo.init, GetEnvironment()->GetMethodID(env, ids.managerInfo.cls, "<init>", "(II)V"));
+
+	RESOLVE(ids.arrayList.cls, findGlobalClass(env, "java/util/ArrayList"));
+	RESOLVE(ids.arrayList.init, GetEnvironment()->GetMethodID(env, ids.arrayList.cls, "<init>", "(I)V"));
+	RESOLVE(ids.arrayList.add, GetEnvironment()->GetMethodID(env, ids.arrayList.cls,
+			"add", "(Ljava/lang/Object;)Z"));
+	return true;
+}
+
+#undef RESOLVE_FIELD
+#undef RESOLVE
+
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
+	JNIEnv *env;
+	if ((*vm)->GetEnv(vm, (void **) &env, JNI_VERSION_1_6) != JNI_OK) {
+		return JNI_ERR;
+	}
+	if (!resolveIds(env)) {
+		__android_log_print(ANDROID_LOG_ERROR, "KernelSU", "failed to resolve JNI ids");
+		return JNI_ERR;
+	}
+	return JNI_VERSION_1_6;
+}
+
 NativeBridgeNP(getVersion, jint) {
     uint32_t version = get_version();
     if (version > 0) {
@@ -56,63 +169,44 @@ NativeBridgeNP(isManager, jboolean) {
 	return is_manager();
 }
 
-static void fillIntArray(JNIEnv *env, jobject list, int *data, int count) {
-	jclass cls = GetEnvironment()->GetObjectClass(env, list);
-	jmethodID add = GetEnvironment()->GetMethodID(env, cls, "add", "(Ljava/lang/Object;)Z");
-	jclass integerCls = GetEnvironment()->FindClass(env, "java/lang/Integer");
-	jmethodID constructor = GetEnvironment()->GetMethodID(env, integerCls, "<init>", "(I)V");
-	for (int i = 0; i < count; ++i) {
-		jobject integer = GetEnvironment()->NewObject(env, integerCls, constructor, data[i]);
-		GetEnvironment()->CallBooleanMethod(env, list, add, integer);
-	}
+// backed by the array, nothing is boxed until Kotlin reads an element
+static jobject intList(JNIEnv *env, const int *data, int count) {
+	jintArray array = GetEnvironment()->NewIntArray(env, count);
+	GetEnvironment()->SetIntArrayRegion(env, array, 0, count, (const jint *) data);
+	jobject list = GetEnvironment()->CallStaticObjectMethod(env, ids.natives.cls, ids.natives.intList, array);
+	GetEnvironment()->DeleteLocalRef(env, array);
+	return list;
 }
 
-static void addIntToList(JNIEnv *env, jobject list, int ele) {
-	jclass cls = GetEnvironment()->GetObjectClass(env, list);
-	jmethodID add = GetEnvironment()->GetMethodID(env, cls, "add", "(Ljava/lang/Object;)Z");
-	jclass integerCls = GetEnvironment()->FindClass(env, "java/lang/Integer");
-	jmethodID constructor = GetEnvironment()->GetMethodID(env, integerCls, "<init>", "(I)V");
-	jobject integer = GetEnvironment()->NewObject(env, integerCls, constructor, ele);
-	GetEnvironment()->CallBooleanMethod(env, list, add, integer);
+// copies at most max elements into data, returns the list size
+static int listToInts(JNIEnv *env, jobject list, int *data, int max) {
+	jintArray array = GetEnvironment()->CallStaticObjectMethod(env, ids.natives.cls, ids.natives.toIntArray, list);
+	if (!array) {
+		return 0;
+	}
+	jsize count = GetEnvironment()->GetArrayLength(env, array);
+	GetEnvironment()->GetIntArrayRegion(env, array, 0, count < max ? count : max, (jint *) data);
+	GetEnvironment()->DeleteLocalRef(env, array);
+	return count;
 }
 
 static uint64_t capListToBits(JNIEnv *env, jobject list) {
-	jclass cls = GetEnvironment()->GetObjectClass(env, list);
-	jmethodID get = GetEnvironment()->GetMethodID(env, cls, "get", "(I)Ljava/lang/Object;");
-	jmethodID size = GetEnvironment()->GetMethodID(env, cls, "size", "()I");
-	jint listSize = GetEnvironment()->CallIntMethod(env, list, size);
-	jclass integerCls = GetEnvironment()->FindClass(env, "java/lang/Integer");
-	jmethodID intValue = GetEnvironment()->GetMethodID(env, integerCls, "intValue", "()I");
-	uint64_t result = 0;
-	for (int i = 0; i < listSize; ++i) {
-		jobject integer = GetEnvironment()->CallObjectMethod(env, list, get, i);
-		int data = GetEnvironment()->CallIntMethod(env, integer, intValue);
+	int caps[CAP_LAST_CAP + 1];
+	int count = listToInts(env, list, caps, CAP_LAST_CAP + 1);
+	if (count > CAP_LAST_CAP + 1) {
+		count = CAP_LAST_CAP + 1;
+	}
 
-		if (cap_valid(data)) {
-			result |= (1ULL << data);
+	uint64_t result = 0;
+	for (int i = 0; i < count; ++i) {
+		if (cap_valid(caps[i])) {
+			result |= (1ULL << caps[i]);
 		}
 	}
 
 	return result;
 }
 
-static int getListSize(JNIEnv *env, jobject list) {
-	jclass cls = GetEnvironment()->GetObjectClass(env, list);
-	jmethodID size = GetEnvironment()->GetMethodID(env, cls, "size", "()I");
-	return GetEnvironment()->CallIntMethod(env, list, size);
-}
-
-static void fillArrayWithList(JNIEnv *env, jobject list, int *data, int count) {
-	jclass cls = GetEnvironment()->GetObjectClass(env, list);
-	jmethodID get = GetEnvironment()->GetMethodID(env, cls, "get", "(I)Ljava/lang/Object;");
-	jclass integerCls = GetEnvironment()->FindClass(env, "java/lang/Integer");
-	jmethodID intValue = GetEnvironment()->GetMethodID(env, integerCls, "intValue", "()I");
-	for (int i = 0; i < count; ++i) {
-		jobject integer = GetEnvironment()->CallObjectMethod(env, list, get, i);
-		data[i] = GetEnvironment()->CallIntMethod(env, integer, intValue);
-	}
-}
-
 NativeBridge(getAppProfile, jobject, jstring pkg, jint uid) {
 	if (GetEnvironment()->GetStringLength(env, pkg) > KSU_MAX_PACKAGE_NAME) {
 		return NULL;
@@ -131,28 +225,10 @@ NativeBridge(getAppProfile, jobject, jstring pkg, jint uid) {
 
 	bool useDefaultProfile = get_app_profile(&profile) != 0;
 
-	jclass cls = GetEnvironment()->FindClass(env, "com/vortexsu/vortexsu/Natives$Profile");
-	jmethodID constructor = GetEnvironment()->GetMethodID(env, cls, "<init>", "()V");
-	jobject obj = GetEnvironment()->NewObject(env, cls, constructor);
-	jfieldID keyField = GetEnvironment()->GetFieldID(env, cls, "name", "Ljava/lang/String;");
-	jfieldID currentUidField = GetEnvironment()->GetFieldID(env, cls, "currentUid", "I");
-	jfieldID allowSuField = GetEnvironment()->GetFieldID(env, cls, "allowSu", "Z");
-
-	jfieldID rootUseDefaultField = GetEnvironment()->GetFieldID(env, cls, "rootUseDefault", "Z");
-	jfieldID rootTemplateField = GetEnvironment()->GetFieldID(env, cls, "rootTemplate", "Ljava/lang/String;");
-
-	jfieldID uidField = GetEnvironment()->GetFieldID(env, cls, "uid", "I");
-	jfieldID gidField = GetEnvironment()->GetFieldID(env, cls, "gid", "I");
-	jfieldID groupsField = GetEnvironment()->GetFieldID(env, cls, "groups", "Ljava/util/List;");
-	jfieldID capabilitiesField = GetEnvironment()->GetFieldID(env, cls, "capabilities", "Ljava/util/List;");
-	jfieldID domainField = GetEnvironment()->GetFieldID(env, cls, "context", "Ljava/lang/String;");
-	jfieldID namespacesField = GetEnvironment()->GetFieldID(env, cls, "namespace", "I");
-
-	jfieldID nonRootUseDefaultField = GetEnvironment()->GetFieldID(env, cls, "nonRootUseDefault", "Z");
-	jfieldID umountModulesField = GetEnvironment()->GetFieldID(env, cls, "umountModules", "Z");
+	jobject obj = GetEnvironment()->NewObject(env, ids.profile.cls, ids.profile.init);
 
-	GetEnvironment()->SetObjectField(env, obj, keyField, GetEnvironment()->NewStringUTF(env, profile.key));
-	GetEnvironment()->SetIntField(env, obj, currentUidField, profile.current_uid);
+	GetEnvironment()->SetObjectField(env, obj, ids.profile.name, GetEnvironment()->NewStringUTF(env, profile.key));
+	GetEnvironment()->SetIntField(env, obj, ids.profile.currentUid, profile.current_uid);
 
 	if (useDefaultProfile) {
 		// no profile found, so just use default profile:
@@ -161,8 +237,8 @@ NativeBridge(getAppProfile, jobject, jstring pkg, jint uid) {
 
 		// allow_su = false
 		// non root use default = true
-		GetEnvironment()->SetBooleanField(env, obj, allowSuField, false);
-		GetEnvironment()->SetBooleanField(env, obj, nonRootUseDefaultField, true);
+		GetEnvironment()->SetBooleanField(env, obj, ids.profile.allowSu, false);
+		GetEnvironment()->SetBooleanField(env, obj, ids.profile.nonRootUseDefault, true);
 
 		return obj;
 	}
@@ -170,63 +246,46 @@ NativeBridge(getAppProfile, jobject, jstring pkg, jint uid) {
 	bool allowSu = profile.allow_su;
 
 	if (allowSu) {
-		GetEnvironment()->SetBooleanField(env, obj, rootUseDefaultField, (jboolean) profile.rp_config.use_default);
+		GetEnvironment()->SetBooleanField(env, obj, ids.profile.rootUseDefault, (jboolean) profile.rp_config.use_default);
 		if (strlen(profile.rp_config.template_name) > 0) {
-			GetEnvironment()->SetObjectField(env, obj, rootTemplateField,
+			GetEnvironment()->SetObjectField(env, obj, ids.profile.rootTemplate,
 											 GetEnvironment()->NewStringUTF(env, profile.rp_config.template_name));
 		}
 
-		GetEnvironment()->SetIntField(env, obj, uidField, profile.rp_config.profile.uid);
-		GetEnvironment()->SetIntField(env, obj, gidField, profile.rp_config.profile.gid);
+		GetEnvironment()->SetIntField(env, obj, ids.profile.uid, profile.rp_config.profile.uid);
+		GetEnvironment()->SetIntField(env, obj, ids.profile.gid, profile.rp_config.profile.gid);
 
-		jobject groupList = GetEnvironment()->GetObjectField(env, obj, groupsField);
 		int groupCount = profile.rp_config.profile.groups_count;
 		if (groupCount > KSU_MAX_GROUPS) {
 			LogDebug("kernel group count too large: %d???", groupCount);
 			groupCount = KSU_MAX_GROUPS;
 		}
-		fillIntArray(env, groupList, profile.rp_config.profile.groups, groupCount);
+		GetEnvironment()->SetObjectField(env, obj, ids.profile.groups,
+										 intList(env, profile.rp_config.profile.groups, groupCount));
 
-		jobject capList = GetEnvironment()->GetObjectField(env, obj, capabilitiesField);
+		int caps[CAP_LAST_CAP + 1];
+		int capCount = 0;
 		for (int i = 0; i <= CAP_LAST_CAP; i++) {
 			if (profile.rp_config.profile.capabilities.effective & (1ULL << i)) {
-				addIntToList(env, capList, i);
+				caps[capCount++] = i;
 			}
 		}
+		GetEnvironment()->SetObjectField(env, obj, ids.profile.capabilities, intList(env, caps, capCount));
 
-		GetEnvironment()->SetObjectField(env, obj, domainField,
+		GetEnvironment()->SetObjectField(env, obj, ids.profile.context,
 										 GetEnvironment()->NewStringUTF(env, profile.rp_config.profile.selinux_domain));
-		GetEnvironment()->SetIntField(env, obj, namespacesField, profile.rp_config.profile.namespaces);
-		GetEnvironment()->SetBooleanField(env, obj, allowSuField, profile.allow_su);
+		GetEnvironment()->SetIntField(env, obj, ids.profile.namespace, profile.rp_config.profile.namespaces);
+		GetEnvironment()->SetBooleanField(env, obj, ids.profile.allowSu, profile.allow_su);
 	} else {
-		GetEnvironment()->SetBooleanField(env, obj, nonRootUseDefaultField, profile.nrp_config.use_default);
-		GetEnvironment()->SetBooleanField(env, obj, umountModulesField, profile.nrp_config.profile.umount_modules);
+		GetEnvironment()->SetBooleanField(env, obj, ids.profile.nonRootUseDefault, profile.nrp_config.use_default);
+		GetEnvironment()->SetBooleanField(env, obj, ids.profile.umountModules, profile.nrp_config.profile.umount_modules);
 	}
 
 	return obj;
 }
 
 NativeBridge(setAppProfile, jboolean, jobject profile) {
-	jclass cls = GetEnvironment()->FindClass(env, "com/vortexsu/vortexsu/Natives$Profile");
-
-	jfieldID keyField = GetEnvironment()->GetFieldID(env, cls, "name", "Ljava/lang/String;");
-	jfieldID currentUidField = GetEnvironment()->GetFieldID(env, cls, "currentUid", "I");
-	jfieldID allowSuField = GetEnvironment()->GetFieldID(env, cls, "allowSu", "Z");
-
-	jfieldID rootUseDefaultField = GetEnvironment()->GetFieldID(env, cls, "rootUseDefault", "Z");
-	jfieldID rootTemplateField = GetEnvironment()->GetFieldID(env, cls, "rootTemplate", "Ljava/lang/String;");
-
-	jfieldID uidField = GetEnvironment()->GetFieldID(env, cls, "uid", "I");
-	jfieldID gidField = GetEnvironment()->GetFieldID(env, cls, "gid", "I");
-	jfieldID groupsField = GetEnvironment()->GetFieldID(env, cls, "groups", "Ljava/util/List;");
-	jfieldID capabilitiesField = GetEnvironment()->GetFieldID(env, cls, "capabilities", "Ljava/util/List;");
-	jfieldID domainField = GetEnvironment()->GetFieldID(env, cls, "context", "Ljava/lang/String;");
-	jfieldID namespacesField = GetEnvironment()->GetFieldID(env, cls, "namespace", "I");
-
-	jfieldID nonRootUseDefaultField = GetEnvironment()->GetFieldID(env, cls, "nonRootUseDefault", "Z");
-	jfieldID umountModulesField = GetEnvironment()->GetFieldID(env, cls, "umountModules", "Z");
-
-	jobject key = GetEnvironment()->GetObjectField(env, profile, keyField);
+	jobject key = GetEnvironment()->GetObjectField(env, profile, ids.profile.name);
 	if (!key) {
 		return false;
 	}
@@ -239,15 +298,15 @@ NativeBridge(setAppProfile, jboolean, jobject profile) {
 	strcpy(p_key, cpkg);
 	GetEnvironment()->ReleaseStringUTFChars(env, (jstring) key, cpkg);
 
-	jint currentUid = GetEnvironment()->GetIntField(env, profile, currentUidField);
+	jint currentUid = GetEnvironment()->GetIntField(env, profile, ids.profile.currentUid);
 
-	jint uid = GetEnvironment()->GetIntField(env, profile, uidField);
-	jint gid = GetEnvironment()->GetIntField(env, profile, gidField);
-	jobject groups = GetEnvironment()->GetObjectField(env, profile, groupsField);
-	jobject capabilities = GetEnvironment()->GetObjectField(env, profile, capabilitiesField);
-	jobject domain = GetEnvironment()->GetObjectField(env, profile, domainField);
-	jboolean allowSu = GetEnvironment()->GetBooleanField(env, profile, allowSuField);
-	jboolean umountModules = GetEnvironment()->GetBooleanField(env, profile, umountModulesField);
+	jint uid = GetEnvironment()->GetIntField(env, profile, ids.profile.uid);
+	jint gid = GetEnvironment()->GetIntField(env, profile, ids.profile.gid);
+	jobject groups = GetEnvironment()->GetObjectField(env, profile, ids.profile.groups);
+	jobject capabilities = GetEnvironment()->GetObjectField(env, profile, ids.profile.capabilities);
+	jobject domain = GetEnvironment()->GetObjectField(env, profile, ids.profile.context);
+	jboolean allowSu = GetEnvironment()->GetBooleanField(env, profile, ids.profile.allowSu);
+	jboolean umountModules = GetEnvironment()->GetBooleanField(env, profile, ids.profile.umountModules);
 
 	struct app_profile p = { 0 };
 	p.version = KSU_APP_PROFILE_VER;
@@ -257,8 +316,8 @@ NativeBridge(setAppProfile, jboolean, jobject profile) {
 	p.current_uid = currentUid;
 
 	if (allowSu) {
-		p.rp_config.use_default = GetEnvironment()->GetBooleanField(env, profile, rootUseDefaultField);
-		jobject templateName = GetEnvironment()->GetObjectField(env, profile, rootTemplateField);
+		p.rp_config.use_default = GetEnvironment()->GetBooleanField(env, profile, ids.profile.rootUseDefault);
+		jobject templateName = GetEnvironment()->GetObjectField(env, profile, ids.profile.rootTemplate);
 		if (templateName) {
 			const char* ctemplateName = GetEnvironment()->GetStringUTFChars(env, (jstring) templateName, nullptr);
 			strcpy(p.rp_config.template_name, ctemplateName);
@@ -268,13 +327,12 @@ NativeBridge(setAppProfile, jboolean, jobject profile) {
 		p.rp_config.profile.uid = uid;
 		p.rp_config.profile.gid = gid;
 
-		int groups_count = getListSize(env, groups);
+		int groups_count = listToInts(env, groups, p.rp_config.profile.groups, KSU_MAX_GROUPS);
 		if (groups_count > KSU_MAX_GROUPS) {
 			LogDebug("groups count too large: %d", groups_count);
 			return false;
 		}
 		p.rp_config.profile.groups_count = groups_count;
-		fillArrayWithList(env, groups, p.rp_config.profile.groups, groups_count);
 
 		p.rp_config.profile.capabilities.effective = capListToBits(env, capabilities);
 
@@ -282,9 +340,9 @@ NativeBridge(setAppProfile, jboolean, jobject profile) {
 		strcpy(p.rp_config.profile.selinux_domain, cdomain);
 		GetEnvironment()->ReleaseStringUTFChars(env, (jstring) domain, cdomain);
 
-		p.rp_config.profile.namespaces = GetEnvironment()->GetIntField(env, profile, namespacesField);
+		p.rp_config.profile.namespaces = GetEnvironment()->GetIntField(env, profile, ids.profile.namespace);
 	} else {
-		p.nrp_config.use_default = GetEnvironment()->GetBooleanField(env, profile, nonRootUseDefaultField);
+		p.nrp_config.use_default = GetEnvironment()->GetBooleanField(env, profile, ids.profile.nonRootUseDefault);
 		p.nrp_config.profile.umount_modules = umountModules;
 	}
 
@@ -371,11 +429,10 @@ NativeBridgeNP(getDynamicManager, jobject) {
 		return NULL;
 	}
 
-	jobject obj = CREATE_JAVA_OBJECT("com/vortexsu/vortexsu/Natives$DynamicManagerConfig");
-	jclass cls = GetEnvironment()->FindClass(env, "com/vortexsu/vortexsu/Natives$DynamicManagerConfig");
-
-	SET_INT_FIELD(obj, cls, size, (jint)config.size);
-	SET_STRING_FIELD(obj, cls, hash, config.hash);
+	jobject obj = GetEnvironment()->NewObject(env, ids.dynamicManagerConfig.cls, ids.dynamicManagerConfig.init);
+	GetEnvironment()->SetIntField(env, obj, ids.dynamicManagerConfig.size, (jint)config.size);
+	GetEnvironment()->SetObjectField(env, obj, ids.dynamicManagerConfig.hash,
+									 GetEnvironment()->NewStringUTF(env, config.hash));
 
 	LogDebug("getDynamicManager: size=0x%x, hash=%.16s...", config.size, config.hash);
 	return obj;
@@ -397,24 +454,22 @@ NativeBridgeNP(getManagersList, jobject) {
 		return NULL;
 	}
 
-	jobject obj = CREATE_JAVA_OBJECT("com/vortexsu/vortexsu/Natives$ManagersList");
-	jclass managerListCls = GetEnvironment()->FindClass(env, "com/vortexsu/vortexsu/Natives$ManagersList");
-
-	SET_INT_FIELD(obj, managerListCls, count, (jint)managerListInfo.count);
+	jobject obj = GetEnvironment()->NewObject(env, ids.managersList.cls, ids.managersList.init);
+	GetEnvironment()->SetIntField(env, obj, ids.managersList.count, (jint)managerListInfo.count);
 
-	jobject managersList = CREATE_ARRAYLIST();
+	jobject managersList = GetEnvironment()->NewObject(env, ids.arrayList.cls, ids.arrayList.init,
+													   (jint)managerListInfo.count);
 
 	for (int i = 0; i < managerListInfo.count; i++) {
-		jobject managerInfo = CREATE_JAVA_OBJECT_WITH_PARAMS(
-				"com/vortexsu/vortexsu/Natives$ManagerInfo",
-				"(II)V",
+		jobject managerInfo = GetEnvironment()->NewObject(env, ids.managerInfo.cls, ids.managerInfo.init,
 				(jint)managerListInfo.managers[i].uid,
 				(jint)managerListInfo.managers[i].signature_index
 		);
-		ADD_TO_LIST(managersList, managerInfo);
+		GetEnvironment()->CallBooleanMethod(env, managersList, ids.arrayList.add, managerInfo);
+		GetEnvironment()->DeleteLocalRef(env, managerInfo);
 	}
 
-	SET_OBJECT_FIELD(obj, managerListCls, managers, managersList);
+	GetEnvironment()->SetObjectField(env, obj, ids.managersList.managers, managersList);
 
 	LogDebug("getManagersList: count=%d", managerListInfo.count);
 	return obj;
@@ -35,6 +35,8 @@ void get_full_version(char* buff);
 #define DYNAMIC_MANAGER_OP_SET 0
 #define DYNAMIC_MANAGER_OP_GET 1
 #define DYNAMIC_MANAGER_OP_CLEAR 2
+#define DYNAMIC_MANAGER_OP_ADD 3
+#define DYNAMIC_MANAGER_OP_REMOVE 4
 
 #define UID_SCANNER_OP_GET_STATUS 0
 #define UID_SCANNER_OP_TOGGLE 1
@@ -133,6 +135,7 @@ enum ksu_feature_id {
     KSU_FEATURE_KERNEL_UMOUNT = 1,
     KSU_FEATURE_ENHANCED_SECURITY = 2,
 	KSU_FEATURE_SULOG = 3,
+    KSU_FEATURE_CLEAN_MNT_NS = 4,
 };
 
 // Generic feature API
@@ -65,6 +65,15 @@ object Natives {
         System.loadLibrary("kernelsu")
     }
 
+    // int list marshalling for jni.c, groups and capabilities cross JNI as int[]
+    @Keep
+    @JvmStatic
+    private fun intList(array: IntArray): List<Int> = array.asList()
+
+    @Keep
+    @JvmStatic
+    private fun toIntArray(list: List<Int>): IntArray = list.toIntArray()
+
     val version: Int
         external get
 
@@ -0,0 +1,178 @@
+//! Boot timeline
+//!
+//! ksud records each boot step with CLOCK_BOOTTIME stamps. The post-fs-data,
+//! service and boot-completed invocations are separate processes, and the
+//! shared clock lets their spans line up on one timeline. Events are appended
+//! to a Chrome trace file in the JSON array format, where the closing bracket
+//! is optional, so Perfetto and chrome://tracing open it as is.
+
+use std::{
+    fs::{self, OpenOptions},
+    io::Write,
+};
+
+use anyhow::{Context, Result};
+use const_format::concatcp;
+use log::warn;
+use serde::{Deserialize, Serialize};
+
+use crate::defs;
+
+const TIMELINE_PATH: &str = concatcp!(defs::LOG_DIR, "boot_timeline.json");
+
+pub const CAT_STEP: &str = "step";
+pub const CAT_MODULE: &str = "module";
+
+#[derive(Serialize, Deserialize)]
+struct Event {
+    name: String,
+    cat: String,
+    ph: String,
+    ts: u64,
+    #[serde(default)]
+    dur: u64,
+    pid: u32,
+    tid: i32,
+}
+
+fn now_us() -> u64 {
+    let mut ts = libc::timespec {
+        tv_sec: 0,
+        tv_nsec: 0,
+    };
+    unsafe {
+        libc::clock_gettime(libc::CLOCK_BOOTTIME, &raw mut ts);
+    }
+    ts.tv_sec as u64 * 1_000_000 + ts.tv_nsec as u64 / 1_000
+}
+
+fn append(event: &Event) {
+    let Ok(mut line) = serde_json::to_string(event) else {
+        return;
+    };
+    line.push_str(",\n");
+
+    // one O_APPEND write per event, scripts record from several threads
+    let result = OpenOptions::new()
+        .append(true)
+        .open(TIMELINE_PATH)
+        .and_then(|mut file| file.write_all(line.as_bytes()));
+    if let Err(e) = result {
+        warn!("Failed to record boot timeline event: {e}");
+    }
+}
+
+/// Start a fresh timeline, called once at the start of post-fs-data
+pub fn reset() {
+    if let Err(e) = fs::write(TIMELINE_PATH, "[\n") {
+        warn!("Failed to reset boot timeline: {e}");
+    }
+}
+
+/// Records a complete event from creation until drop
+pub struct Span {
+    name: String,
+    cat: &'static str,
+    start: u64,
+}
+
+impl Span {
+    pub fn new(cat: &'static str, name: impl Into<String>) -> Self {
+        Self {
+            name: name.into(),
+            cat,
+            start: now_us(),
+        }
+    }
+}
+
+impl Drop for Span {
+    fn drop(&mut self) {
+        append(&Event {
+            name: std::mem::take(&mut self.name),
+            cat: self.cat.to_string(),
+            ph: "X".to_string(),
+            ts: self.start,
+            dur: now_us().saturating_sub(self.start),
+            pid: std::process::id(),
+            tid: unsafe { libc::gettid() },
+        });
+    }
+}
+
+/// Run `f` as a timed boot step
+pub fn step<T>(name: &str, f: impl FnOnce() -> T) -> T {
+    let _span = Span::new(CAT_STEP, name);
+    f()
+}
+
+/// Record an instant event, e.g. boot completed
+pub fn mark(name: &str) {
+    append(&Event {
+        name: name.to_string(),
+        cat: CAT_STEP.to_string(),
+        ph: "i".to_string(),
+        ts: now_us(),
+        dur: 0,
+        pid: std::process::id(),
+        tid: unsafe { libc::gettid() },
+    });
+}
+
+fn load() -> Result<Vec<Event>> {
+    let content = fs::read_to_string(TIMELINE_PATH)
+        .with_context(|| format!("Failed to read {TIMELINE_PATH}"))?;
+    let json = format!("{}]", content.trim_end().trim_end_matches(','));
+    serde_json::from_str(&json).with_context(|| format!("Failed to parse {TIMELINE_PATH}"))
+}
+
+fn print_slowest(title: &str, events: &[&Event], top: usize) {
+    println!("{title}:");
+    for event in events.iter().take(top) {
+        println!("  {:>8.1} ms  {}", event.dur as f64 / 1000.0, event.name);
+    }
+}
+
+/// Print the slowest boot steps and module scripts of the last boot
+pub fn print_summary(top: usize) -> Result<()> {
+    let events = load()?;
+
+    let start = events.iter().map(|e| e.ts).min().unwrap_or_default();
+    let end = events
+        .iter()
+        .map(|e| e.ts + e.dur)
+        .max()
+        .unwrap_or_default();
+    println!("Timeline: {TIMELINE_PATH}");
+    println!(
+        "Recorded span: {:.1} ms",
+        end.saturating_sub(start) as f64 / 1000.0
+    );
+    if let Some(done) = events
+        .iter()
+        .find(|e| e.ph == "i" && e.name == "boot-completed")
+    {
+        println!(
+            "boot-completed at +{:.1} ms",
+            done.ts.saturating_sub(start) as f64 / 1000.0
+        );
+    }
+
+    let mut spans: Vec<&Event> = events.iter().filter(|e| e.ph == "X").collect();
+    spans.sort_unstable_by(|a, b| b.dur.cmp(&a.dur));
+
+    let steps: Vec<&Event> = spans
+        .iter()
+        .copied()
+        .filter(|e| e.cat == CAT_STEP)
+        .collect();
+    let modules: Vec<&Event> = spans
+        .iter()
+        .copied()
+        .filter(|e| e.cat == CAT_MODULE)
+        .collect();
+
+    print_slowest("Slowest steps", &steps, top);
+    print_slowest("Slowest modules", &modules, top);
+    Ok(())
+}
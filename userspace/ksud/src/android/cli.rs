@@ -9,7 +9,7 @@ use log::LevelFilter;
 use crate::android::susfs;
 use crate::{
     android::{
-        debug, dynamic_manager, feature, init_event, ksucalls,
+        boot_timeline, debug, dynamic_manager, feature, init_event, ksucalls,
         module::{self, module_config},
         profile, sepolicy, su, umount, utils,
     },
@@ -176,6 +176,24 @@ enum Debug {
         #[command(subcommand)]
         command: MarkCommand,
     },
+
+    /// Show per-hook call counts and latency, needs the hook_stats feature
+    Stats {
+        /// clear the counters after reading them
+        #[arg(short, long, default_value = "false")]
+        reset: bool,
+
+        /// also list hooks and ioctls that were never called
+        #[arg(short, long, default_value = "false")]
+        all: bool,
+    },
+
+    /// Show the slowest boot steps and modules of the last boot
+    BootTimeline {
+        /// number of entries to show per section
+        #[arg(short, long, default_value = "10")]
+        top: usize,
+    },
 }
 
 #[derive(clap::Subcommand, Debug)]
@@ -274,7 +292,11 @@ enum Module {
     },
 
     /// list all modules
-    List,
+    List {
+        /// print one JSON object per line as modules are read
+        #[arg(long, default_value = "false")]
+        stream: bool,
+    },
 
     /// manage module configuration
     Config {
@@ -566,7 +588,7 @@ pub fn run() -> Result<()> {
                 Module::Lua { id, function } => {
                     module::run_lua(&id, &function, false, true).map_err(|e| anyhow::anyhow!("{e}"))
                 }
-                Module::List => module::list_modules(),
+                Module::List { stream } => module::list_modules(stream),
                 Module::Config { command } => {
                     // Get module ID from environment variable
                     let module_id = std::env::var("KSU_MODULE").map_err(|_| {
@@ -705,6 +727,8 @@ pub fn run() -> Result<()> {
                 MarkCommand::Unmark { pid } => debug::mark_unset(pid),
                 MarkCommand::Refresh => debug::mark_refresh(),
             },
+            Debug::Stats { reset, all } => debug::print_stats(reset, all),
+            Debug::BootTimeline { top } => boot_timeline::print_summary(top),
         },
 
         Commands::BootPatch(boot_patch) => crate::boot_patch::patch(boot_patch),
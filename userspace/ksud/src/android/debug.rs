@@ -91,3 +91,50 @@ pub fn mark_refresh() -> Result<()> {
     println!("Refreshed mark for all running processes");
     Ok(())
 }
+
+/// Latency below which `quantile` of the calls finished, from the log2 histogram
+fn percentile(hist: &[u64], count: u64, quantile: f64) -> u64 {
+    let target = (count as f64 * quantile).ceil() as u64;
+    let mut seen = 0;
+    for (i, n) in hist.iter().enumerate() {
+        seen += n;
+        if seen >= target {
+            return 2u64 << i;
+        }
+    }
+    2u64 << (hist.len() - 1)
+}
+
+/// Print hook and ioctl counters collected while the hook_stats feature is on
+pub fn print_stats(reset: bool, all: bool) -> Result<()> {
+    let stats = ksucalls::get_stats(reset)?;
+    if !stats.iter().any(|entry| entry.count != 0) {
+        println!("No hook calls recorded, is the hook_stats feature enabled?");
+    }
+
+    println!(
+        "{:<26} {:>10} {:>12} {:>10} {:>10} {:>10}",
+        "hook", "calls", "total(us)", "avg(ns)", "p50<(ns)", "p99<(ns)"
+    );
+    for entry in stats.iter().filter(|entry| all || entry.count != 0) {
+        let avg = entry.total_ns.checked_div(entry.count).unwrap_or_default();
+        let (p50, p99) = if entry.count == 0 {
+            (0, 0)
+        } else {
+            (
+                percentile(&entry.hist, entry.count, 0.5),
+                percentile(&entry.hist, entry.count, 0.99),
+            )
+        };
+        println!(
+            "{:<26} {:>10} {:>12} {:>10} {:>10} {:>10}",
+            entry.name(),
+            entry.count,
+            entry.total_ns / 1000,
+            avg,
+            p50,
+            p99
+        );
+    }
+    Ok(())
+}
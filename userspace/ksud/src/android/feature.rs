@@ -25,6 +25,8 @@ pub enum FeatureId {
     KernelUmount = 1,
     EnhancedSecurity = 2,
     SuLog = 3,
+    CleanMntNs = 4,
+    HookStats = 5,
 }
 
 impl FeatureId {
@@ -34,6 +36,8 @@ impl FeatureId {
             1 => Some(Self::KernelUmount),
             2 => Some(Self::EnhancedSecurity),
             3 => Some(Self::SuLog),
+            4 => Some(Self::CleanMntNs),
+            5 => Some(Self::HookStats),
             _ => None,
         }
     }
@@ -44,6 +48,8 @@ impl FeatureId {
             Self::KernelUmount => "kernel_umount",
             Self::EnhancedSecurity => "enhanced_security",
             Self::SuLog => "sulog",
+            Self::CleanMntNs => "clean_mnt_ns",
+            Self::HookStats => "hook_stats",
         }
     }
 
@@ -61,6 +67,12 @@ impl FeatureId {
             Self::SuLog => {
                 "SU Log - enables logging of SU command usage to kernel log for auditing purposes"
             }
+            Self::CleanMntNs => {
+                "Clean Mount Namespace - umounted apps reuse a pre-built namespace without module mounts"
+            }
+            Self::HookStats => {
+                "Hook Stats - count calls and time of kernel hooks, read with 'ksud debug stats'"
+            }
         }
     }
 }
@@ -71,6 +83,8 @@ fn parse_feature_id(name: &str) -> Result<FeatureId> {
         "kernel_umount" | "1" => Ok(FeatureId::KernelUmount),
         "enhanced_security" | "2" => Ok(FeatureId::EnhancedSecurity),
         "sulog" | "3" => Ok(FeatureId::SuLog),
+        "clean_mnt_ns" | "4" => Ok(FeatureId::CleanMntNs),
+        "hook_stats" | "5" => Ok(FeatureId::HookStats),
         _ => bail!("Unknown feature: {name}"),
     }
 }
@@ -163,9 +177,18 @@ pub fn save_binary_config(features: &HashMap<u32, u64>) -> Result<()> {
 pub fn apply_config(features: &HashMap<u32, u64>) {
     log::info!("Applying feature configuration to kernel...");
 
+    let features: Vec<(u32, u64)> = features.iter().map(|(&id, &value)| (id, value)).collect();
+    let results = match ksucalls::set_features(&features) {
+        Ok(results) => results,
+        Err(e) => {
+            log::warn!("Failed to set features: {e}");
+            return;
+        }
+    };
+
     let mut applied = 0;
-    for (&id, &value) in features {
-        match ksucalls::set_feature(id, value) {
+    for (&(id, value), result) in features.iter().zip(results) {
+        match result {
             Ok(()) => {
                 if let Some(feature_id) = FeatureId::from_u32(id) {
                     log::info!("Set feature {} to {value}", feature_id.name());
@@ -274,11 +297,19 @@ pub fn list_features() {
         FeatureId::KernelUmount,
         FeatureId::EnhancedSecurity,
         FeatureId::SuLog,
+        FeatureId::CleanMntNs,
+        FeatureId::HookStats,
     ];
 
-    for feature_id in &all_features {
+    let ids = all_features.map(|feature_id| feature_id as u32);
+    let states = ksucalls::get_features(&ids).unwrap_or_default();
+
+    for (i, feature_id) in all_features.iter().enumerate() {
         let id = *feature_id as u32;
-        let (value, supported) = ksucalls::get_feature(id).unwrap_or((0, false));
+        let (value, supported) = match states.get(i) {
+            Some(Ok(state)) => *state,
+            _ => (0, false),
+        };
 
         let status = if !supported {
             "NOT_SUPPORTED".to_string()
@@ -336,6 +367,8 @@ pub fn save_config() -> Result<()> {
         FeatureId::KernelUmount,
         FeatureId::EnhancedSecurity,
         FeatureId::SuLog,
+        FeatureId::CleanMntNs,
+        FeatureId::HookStats,
     ];
 
     for feature_id in &all_features {
@@ -356,7 +389,8 @@ pub fn save_config() -> Result<()> {
     Ok(())
 }
 
-pub fn check_feature(id: &str) -> Result<()> {
+/// "managed", "supported" or "unsupported"
+pub fn feature_status(id: &str) -> Result<&'static str> {
     let feature_id = parse_feature_id(id)?;
 
     // Check if this feature is managed by any module
@@ -366,20 +400,22 @@ pub fn check_feature(id: &str) -> Result<()> {
         .any(|features| features.iter().any(|f| f == feature_id.name()));
 
     if is_managed {
-        println!("managed");
-        return Ok(());
+        return Ok("managed");
     }
 
     // Check if the feature is supported by kernel
     let (_value, supported) = ksucalls::get_feature(feature_id as u32)
         .with_context(|| format!("Failed to get feature {id}"))?;
 
-    if supported {
-        println!("supported");
+    Ok(if supported {
+        "supported"
     } else {
-        println!("unsupported");
-    }
+        "unsupported"
+    })
+}
 
+pub fn check_feature(id: &str) -> Result<()> {
+    println!("{}", feature_status(id)?);
     Ok(())
 }
 
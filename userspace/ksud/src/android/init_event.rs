@@ -1,4 +1,4 @@
-use std::path::Path;
+use std::{path::Path, time::Instant};
 
 use anyhow::{Context, Result};
 use log::{info, warn};
@@ -7,9 +7,9 @@ use log::{info, warn};
 use crate::android::kpm;
 use crate::{
     android::{
-        dynamic_manager, ksucalls,
+        boot_timeline, dynamic_manager, ksucalls,
         module::{self, handle_updated_modules, metamodule, prune_modules},
-        restorecon,
+        restorecon, sepolicy_cache,
         utils::{self, is_safe_mode},
     },
     assets, defs,
@@ -31,6 +31,9 @@ pub fn on_post_data_fs() -> Result<()> {
         let _ = catch_bootlog("dmesg", &["dmesg", "-w", "-r"]);
     }
 
+    boot_timeline::reset();
+    let _post_fs_data = boot_timeline::Span::new(boot_timeline::CAT_STEP, "post-fs-data");
+
     if utils::has_magisk() {
         warn!("Magisk detected, skip post-fs-data!");
         return Ok(());
@@ -44,17 +47,20 @@ pub fn on_post_data_fs() -> Result<()> {
         warn!("safe mode, skip common post-fs-data.d scripts");
     } else {
         // Then exec common post-fs-data scripts
-        if let Err(e) = crate::android::module::exec_common_scripts("post-fs-data.d", true) {
+        if let Err(e) = boot_timeline::step("post-fs-data.d", || {
+            crate::android::module::exec_common_scripts("post-fs-data.d", true)
+        }) {
             warn!("exec common post-fs-data scripts failed: {e}");
         }
-        if let Err(e) = dynamic_manager::booted_load() {
+        if let Err(e) = boot_timeline::step("dynamic_manager", dynamic_manager::booted_load) {
             warn!("set dynamic manager failed: {e}");
         }
     }
 
     let module_dir = defs::MODULE_DIR;
 
-    assets::ensure_binaries(true).with_context(|| "Failed to extract bin assets")?;
+    boot_timeline::step("ensure_binaries", || assets::ensure_binaries(true))
+        .with_context(|| "Failed to extract bin assets")?;
 
     // if we are in safe mode, we should disable all modules
     if safe_mode {
@@ -65,68 +71,78 @@ pub fn on_post_data_fs() -> Result<()> {
         return Ok(());
     }
 
-    if let Err(e) = handle_updated_modules() {
+    if let Err(e) = boot_timeline::step("handle_updated_modules", handle_updated_modules) {
         warn!("handle updated modules failed: {e}");
     }
 
-    if let Err(e) = prune_modules() {
+    if let Err(e) = boot_timeline::step("prune_modules", prune_modules) {
         warn!("prune modules failed: {e}");
     }
 
-    if let Err(e) = restorecon::restorecon() {
+    if let Err(e) = boot_timeline::step("restorecon", restorecon::restorecon) {
         warn!("restorecon failed: {e}");
     }
 
-    // load sepolicy.rule
-    if crate::android::module::load_sepolicy_rule().is_err() {
-        warn!("load sepolicy.rule failed");
-    }
-
-    if let Err(e) = crate::android::profile::apply_sepolies() {
-        warn!("apply root profile sepolicy failed: {e}");
+    // load sepolicy.rule and root profile sepolicy
+    if let Err(e) = boot_timeline::step("apply_sepolicy", sepolicy_cache::apply) {
+        warn!("apply sepolicy failed: {e}");
     }
 
     // load feature config
     if is_safe_mode() {
         warn!("safe mode, skip load feature config");
-    } else if let Err(e) = crate::android::feature::init_features() {
+    } else if let Err(e) =
+        boot_timeline::step("init_features", crate::android::feature::init_features)
+    {
         warn!("init features failed: {e}");
     }
 
     #[cfg(all(target_arch = "aarch64", target_os = "android"))]
-    if let Err(e) = kpm::booted_load() {
+    if let Err(e) = boot_timeline::step("kpm", kpm::booted_load) {
         warn!("KPM: Failed to start KPM watcher: {e}");
     }
 
+    let deadline = Instant::now() + defs::POST_FS_DATA_BUDGET;
+
     // execute metamodule post-fs-data script first (priority)
-    if let Err(e) = metamodule::exec_stage_script("post-fs-data", true) {
+    if let Err(e) = boot_timeline::step("metamodule post-fs-data", || {
+        metamodule::exec_stage_script("post-fs-data", true)
+    }) {
         warn!("exec metamodule post-fs-data script failed: {e}");
     }
 
-    // exec modules post-fs-data scripts
-    // TODO: Add timeout
-    if let Err(e) = module::exec_stage_script("post-fs-data", true) {
+    // exec modules post-fs-data scripts in parallel, bounded by the budget
+    if let Err(e) = boot_timeline::step("post-fs-data scripts", || {
+        module::stage::exec_stage_parallel("post-fs-data", deadline)
+    }) {
         warn!("exec post-fs-data scripts failed: {e}");
     }
 
     // exec lua script on post-fs-data
     #[cfg(all(target_os = "android", target_arch = "aarch64"))]
-    if let Err(e) = module::exec_stage_lua("post-fs-data", true, "kernelsu") {
+    if let Err(e) = boot_timeline::step("post-fs-data lua", || {
+        module::exec_stage_lua("post-fs-data", true, "kernelsu")
+    }) {
         warn!("Failed to exec post-fs-data lua: {e}");
     }
 
     // load system.prop
-    if let Err(e) = module::load_system_prop() {
+    if let Err(e) = boot_timeline::step("load_system_prop", module::load_system_prop) {
         warn!("load system.prop failed: {e}");
     }
 
     // execute metamodule mount script
-    if let Err(e) = metamodule::exec_mount_script(module_dir) {
+    if let Err(e) = boot_timeline::step("metamodule mount", || {
+        metamodule::exec_mount_script(module_dir)
+    }) {
         warn!("execute metamodule mount failed: {e}");
     }
 
     // Load umount config and apply to kernel
-    if let Err(e) = crate::android::umount::load_umount_config() {
+    if let Err(e) = boot_timeline::step(
+        "load_umount_config",
+        crate::android::umount::load_umount_config,
+    ) {
         warn!("load umount config failed: {e}");
     }
 
@@ -138,6 +154,7 @@ pub fn on_post_data_fs() -> Result<()> {
 }
 
 fn run_stage(stage: &str, block: bool) {
+    let _span = boot_timeline::Span::new(boot_timeline::CAT_STEP, stage);
     utils::umask(0);
 
     if utils::has_magisk() {
@@ -178,6 +195,7 @@ pub fn on_services() {
 
 pub fn on_boot_completed() {
     ksucalls::report_boot_complete();
+    boot_timeline::mark("boot-completed");
     info!("on_boot_completed triggered!");
 
     run_stage("boot-completed", false);
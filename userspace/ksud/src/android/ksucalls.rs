@@ -20,6 +20,10 @@ const KSU_IOCTL_GET_WRAPPER_FD: i32 = _IOW::<()>(K, 15);
 const KSU_IOCTL_MANAGE_MARK: i32 = _IOWR::<()>(K, 16);
 const KSU_IOCTL_NUKE_EXT4_SYSFS: i32 = _IOW::<()>(K, 17);
 const KSU_IOCTL_ADD_TRY_UMOUNT: i32 = _IOW::<()>(K, 18);
+const KSU_IOCTL_SET_TRY_UMOUNT_LIST: i32 = _IOWR::<()>(K, 19);
+const KSU_IOCTL_GET_FEATURES: i32 = _IOWR::<()>(K, 20);
+const KSU_IOCTL_SET_FEATURES: i32 = _IOWR::<()>(K, 21);
+const KSU_IOCTL_GET_STATS: i32 = _IOWR::<()>(K, 22);
 
 const SUKISU_IOCTL_DYNAMIC_MANAGER: i32 = _IOWR::<()>(K, 103);
 
@@ -63,6 +67,57 @@ struct SetFeatureCmd {
     value: u64,
 }
 
+#[repr(C)]
+#[derive(Clone, Copy, Default)]
+struct FeatureEntry {
+    feature_id: u32,
+    supported: u32, // output
+    value: u64,     // input for set, output for get
+    result: i32,    // output: 0 or -errno
+    reserved: u32,
+}
+
+#[repr(C)]
+#[derive(Clone, Copy, Default)]
+struct FeaturesCmd {
+    arg: u64,   // FeatureEntry array
+    count: u32, // at most KSU_FEATURES_MAX_COUNT
+}
+
+const KSU_FEATURES_MAX_COUNT: usize = 64;
+
+const KSU_STATS_BUCKETS: usize = 32;
+const KSU_STATS_RESET: u32 = 1;
+
+#[repr(C)]
+#[derive(Clone, Copy, Default)]
+pub struct HookStats {
+    name: [u8; 32],
+    pub count: u64,
+    pub total_ns: u64,
+    /// hist[i] counts calls that took [2^i, 2^(i+1)) ns
+    pub hist: [u64; KSU_STATS_BUCKETS],
+}
+
+impl HookStats {
+    pub fn name(&self) -> &str {
+        let len = self
+            .name
+            .iter()
+            .position(|&b| b == 0)
+            .unwrap_or(self.name.len());
+        std::str::from_utf8(&self.name[..len]).unwrap_or_default()
+    }
+}
+
+#[repr(C)]
+#[derive(Clone, Copy, Default)]
+struct GetStatsCmd {
+    arg: u64,   // HookStats array
+    count: u32, // input: capacity, output: entries available
+    flags: u32, // KSU_STATS_RESET
+}
+
 #[repr(C)]
 #[derive(Clone, Copy, Default)]
 struct GetWrapperFdCmd {
@@ -92,6 +147,14 @@ struct AddTryUmountCmd {
     mode: u8,   // denotes what to do with it 0:wipe_list 1:add_to_list 2:delete_entry
 }
 
+#[repr(C)]
+#[derive(Clone, Copy, Default)]
+struct SetTryUmountListCmd {
+    arg: u64,      // packed records: path_len u32, path bytes, flags u32
+    buf_size: u32, // size of the record buffer
+    count: u32,    // output: entries in the new list
+}
+
 #[repr(C)]
 #[derive(Clone, Copy)]
 struct DynamicManage {
@@ -245,6 +308,87 @@ pub fn set_feature(feature_id: u32, value: u64) -> std::io::Result<()> {
     Ok(())
 }
 
+fn features_call(request: i32, entries: &mut [FeatureEntry]) -> std::io::Result<()> {
+    for chunk in entries.chunks_mut(KSU_FEATURES_MAX_COUNT) {
+        let mut cmd = FeaturesCmd {
+            arg: chunk.as_mut_ptr() as u64,
+            count: chunk.len() as u32,
+        };
+        ksuctl(request, &raw mut cmd)?;
+    }
+    Ok(())
+}
+
+/// Get (value, supported) of every feature in `ids` in one call. Falls back
+/// to one call per feature on kernels without it.
+pub fn get_features(ids: &[u32]) -> std::io::Result<Vec<std::io::Result<(u64, bool)>>> {
+    let mut entries: Vec<FeatureEntry> = ids
+        .iter()
+        .map(|&feature_id| FeatureEntry {
+            feature_id,
+            ..Default::default()
+        })
+        .collect();
+
+    match features_call(KSU_IOCTL_GET_FEATURES, &mut entries) {
+        Ok(()) => Ok(entries
+            .iter()
+            .map(|entry| {
+                if entry.result == 0 || entry.supported == 0 {
+                    Ok((entry.value, entry.supported != 0))
+                } else {
+                    Err(std::io::Error::from_raw_os_error(-entry.result))
+                }
+            })
+            .collect()),
+        Err(e) if e.raw_os_error() == Some(libc::ENOTTY) => {
+            Ok(ids.iter().map(|&id| get_feature(id)).collect())
+        }
+        Err(e) => Err(e),
+    }
+}
+
+/// Read the per-hook counters, hooks first and then one entry per ioctl
+pub fn get_stats(reset: bool) -> std::io::Result<Vec<HookStats>> {
+    let mut cmd = GetStatsCmd::default();
+    ksuctl(KSU_IOCTL_GET_STATS, &raw mut cmd)?;
+
+    let mut entries = vec![HookStats::default(); cmd.count as usize];
+    cmd.arg = entries.as_mut_ptr() as u64;
+    cmd.flags = if reset { KSU_STATS_RESET } else { 0 };
+    ksuctl(KSU_IOCTL_GET_STATS, &raw mut cmd)?;
+    entries.truncate(cmd.count as usize);
+    Ok(entries)
+}
+
+/// Set every (id, value) pair in one call, in order. Falls back to one call
+/// per feature on kernels without it.
+pub fn set_features(features: &[(u32, u64)]) -> std::io::Result<Vec<std::io::Result<()>>> {
+    let mut entries: Vec<FeatureEntry> = features
+        .iter()
+        .map(|&(feature_id, value)| FeatureEntry {
+            feature_id,
+            value,
+            ..Default::default()
+        })
+        .collect();
+
+    match features_call(KSU_IOCTL_SET_FEATURES, &mut entries) {
+        Ok(()) => Ok(entries
+            .iter()
+            .map(|entry| match entry.result {
+                0 => Ok(()),
+                err => Err(std::io::Error::from_raw_os_error(-err)),
+            })
+            .collect()),
+        Err(e) if e.raw_os_error() == Some(libc::ENOTTY) => Ok(features
+            .iter()
+            .map(|&(id, value)| set_feature(id, value))
+            .collect()),
+        Err(e) => Err(e),
+    }
+}
+
 pub fn get_wrapped_fd(fd: RawFd) -> std::io::Result<RawFd> {
     let mut cmd = GetWrapperFdCmd { fd, flags: 0 };
     let result = ksuctl(KSU_IOCTL_GET_WRAPPER_FD, &raw mut cmd)?;
@@ -339,6 +483,37 @@ pub fn umount_list_del(path: &str) -> anyhow::Result<()> {
     Ok(())
 }
 
+/// Replace the whole umount list with `entries` in one call, duplicates are
+/// dropped by the kernel. Falls back to wipe + add on kernels without it.
+pub fn umount_list_set(entries: &[(String, u32)]) -> anyhow::Result<u32> {
+    let mut buf = Vec::new();
+    for (path, flags) in entries {
+        let path_bytes = path.as_bytes();
+        buf.extend_from_slice(&(path_bytes.len() as u32).to_le_bytes());
+        buf.extend_from_slice(path_bytes);
+        buf.extend_from_slice(&flags.to_le_bytes());
+    }
+
+    let mut cmd = SetTryUmountListCmd {
+        arg: buf.as_ptr() as u64,
+        buf_size: buf.len() as u32,
+        count: 0,
+    };
+    match ksuctl(KSU_IOCTL_SET_TRY_UMOUNT_LIST, &raw mut cmd) {
+        Ok(_) => return Ok(cmd.count),
+        Err(e) if e.raw_os_error() == Some(libc::ENOTTY) => {}
+        Err(e) => return Err(e.into()),
+    }
+
+    umount_list_wipe()?;
+    let mut count = 0;
+    for (path, flags) in entries {
+        umount_list_add(path, *flags)?;
+        count += 1;
+    }
+    Ok(count)
+}
+
 pub fn dynamic_manager_set(size: u32, hash: [u8; 64]) -> anyhow::Result<()> {
     let mut cmd = DynamicManage {
         operation: SUKISU_DYNAMIC_MANAGER_SET,
@@ -380,16 +555,24 @@ struct ListTryUmountCmd {
 
 /// List all mount points in umount list
 pub fn umount_list_list() -> anyhow::Result<String> {
-    const BUF_SIZE: usize = 4096;
-    let mut buffer = vec![0u8; BUF_SIZE];
-    let mut cmd = ListTryUmountCmd {
-        arg: buffer.as_mut_ptr() as u64,
-        buf_size: BUF_SIZE as u32,
-    };
-    ksuctl(KSU_IOCTL_LIST_TRY_UMOUNT, &raw mut cmd)?;
+    let mut buffer = vec![0u8; 4096];
+    loop {
+        let mut cmd = ListTryUmountCmd {
+            arg: buffer.as_mut_ptr() as u64,
+            buf_size: buffer.len() as u32,
+        };
+        match ksuctl(KSU_IOCTL_LIST_TRY_UMOUNT, &raw mut cmd) {
+            Ok(_) => break,
+            // kernel tells us how much it needs, the list may grow meanwhile
+            Err(e) if e.raw_os_error() == Some(libc::ENOSPC) => {
+                buffer.resize(cmd.buf_size as usize, 0);
+            }
+            Err(e) => return Err(e.into()),
+        }
+    }
 
     // Find null terminator or end of buffer
-    let len = buffer.iter().position(|&b| b == 0).unwrap_or(BUF_SIZE);
+    let len = buffer.iter().position(|&b| b == 0).unwrap_or(buffer.len());
     let result = String::from_utf8_lossy(&buffer[..len]).to_string();
     Ok(result)
 }
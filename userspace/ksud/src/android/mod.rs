@@ -1,3 +1,4 @@
+mod boot_timeline;
 pub mod cli;
 mod debug;
 mod dynamic_manager;
@@ -10,6 +11,7 @@ mod module;
 mod profile;
 mod restorecon;
 mod sepolicy;
+mod sepolicy_cache;
 mod su;
 #[cfg(all(target_arch = "aarch64", target_os = "android"))]
 mod susfs;
@@ -0,0 +1,195 @@
+//! Persistent module index
+//!
+//! The manager runs `ksud module list` every time its module screen opens.
+//! Building one module's entry means parsing module.prop, probing the marker
+//! files and merging the module's configs. So every entry is cached in a
+//! binary index and reused while the module's stamp is unchanged. The stamp
+//! covers:
+//! - the module directory mtime; markers are created and removed directly in
+//!   it, so any marker change moves it
+//! - module.prop mtime and size
+//! - the module's config directory mtime; configs are saved by rename
+
+use std::{
+    collections::HashMap,
+    fs::{self, File},
+    io::{BufReader, BufWriter, Read, Write},
+    os::unix::fs::MetadataExt,
+    path::Path,
+};
+
+use anyhow::{Result, bail};
+use const_format::concatcp;
+use log::warn;
+
+use crate::{android::module, defs};
+
+const INDEX_PATH: &str = concatcp!(defs::WORKING_DIR, ".module_index");
+const INDEX_MAGIC: u32 = 0x4B53_4D49; // KSMI
+const INDEX_VERSION: u32 = 1;
+
+#[derive(Clone, Copy, PartialEq, Eq)]
+struct Stamp {
+    dir: i64,
+    prop_mtime: i64,
+    prop_size: i64,
+    config: i64,
+}
+
+type Index = HashMap<String, (Stamp, HashMap<String, String>)>;
+
+fn mtime_ns(meta: &fs::Metadata) -> i64 {
+    meta.mtime() * 1_000_000_000 + meta.mtime_nsec()
+}
+
+/// None when the directory isn't a module (no module.prop)
+fn module_stamp(path: &Path, id: &str) -> Option<Stamp> {
+    let dir = fs::metadata(path).ok()?;
+    let prop = fs::metadata(path.join("module.prop")).ok()?;
+    let config = fs::metadata(Path::new(defs::MODULE_CONFIG_DIR).join(id))
+        .map(|meta| mtime_ns(&meta))
+        .unwrap_or_default();
+
+    Some(Stamp {
+        dir: mtime_ns(&dir),
+        prop_mtime: mtime_ns(&prop),
+        prop_size: prop.size() as i64,
+        config,
+    })
+}
+
+fn read_u32(reader: &mut impl Read) -> std::io::Result<u32> {
+    let mut buf = [0u8; 4];
+    reader.read_exact(&mut buf)?;
+    Ok(u32::from_le_bytes(buf))
+}
+
+fn read_i64(reader: &mut impl Read) -> std::io::Result<i64> {
+    let mut buf = [0u8; 8];
+    reader.read_exact(&mut buf)?;
+    Ok(i64::from_le_bytes(buf))
+}
+
+fn read_string(reader: &mut impl Read) -> Result<String> {
+    let len = read_u32(reader)? as usize;
+    let mut buf = vec![0u8; len];
+    reader.read_exact(&mut buf)?;
+    Ok(String::from_utf8(buf)?)
+}
+
+fn write_string(writer: &mut impl Write, s: &str) -> std::io::Result<()> {
+    writer.write_all(&(s.len() as u32).to_le_bytes())?;
+    writer.write_all(s.as_bytes())
+}
+
+fn load_index() -> Result<Index> {
+    let mut reader = BufReader::new(File::open(INDEX_PATH)?);
+
+    if read_u32(&mut reader)? != INDEX_MAGIC || read_u32(&mut reader)? != INDEX_VERSION {
+        bail!("Invalid module index header");
+    }
+
+    let count = read_u32(&mut reader)?;
+    let mut index = HashMap::with_capacity(count as usize);
+    for _ in 0..count {
+        let name = read_string(&mut reader)?;
+        let stamp = Stamp {
+            dir: read_i64(&mut reader)?,
+            prop_mtime: read_i64(&mut reader)?,
+            prop_size: read_i64(&mut reader)?,
+            config: read_i64(&mut reader)?,
+        };
+        let props = read_u32(&mut reader)?;
+        let mut module = HashMap::with_capacity(props as usize);
+        for _ in 0..props {
+            let key = read_string(&mut reader)?;
+            let value = read_string(&mut reader)?;
+            module.insert(key, value);
+        }
+        index.insert(name, (stamp, module));
+    }
+
+    Ok(index)
+}
+
+fn save_index(index: &Index) -> Result<()> {
+    let temp_path = concatcp!(INDEX_PATH, ".tmp");
+    let mut writer = BufWriter::new(File::create(temp_path)?);
+
+    writer.write_all(&INDEX_MAGIC.to_le_bytes())?;
+    writer.write_all(&INDEX_VERSION.to_le_bytes())?;
+    writer.write_all(&(index.len() as u32).to_le_bytes())?;
+    for (name, (stamp, module)) in index {
+        write_string(&mut writer, name)?;
+        for value in [stamp.dir, stamp.prop_mtime, stamp.prop_size, stamp.config] {
+            writer.write_all(&value.to_le_bytes())?;
+        }
+        writer.write_all(&(module.len() as u32).to_le_bytes())?;
+        for (key, value) in module {
+            write_string(&mut writer, key)?;
+            write_string(&mut writer, value)?;
+        }
+    }
+    writer.flush()?;
+    drop(writer);
+
+    fs::rename(temp_path, INDEX_PATH)?;
+    Ok(())
+}
+
+/// Call `f` with the `module list` entry of every module in `modules_dir`,
+/// rebuilding only the entries whose stamp changed
+pub fn for_each_module(modules_dir: &Path, mut f: impl FnMut(&HashMap<String, String>)) {
+    let mut index = load_index().unwrap_or_default();
+    let mut fresh: Index = HashMap::with_capacity(index.len());
+    let mut dirty = false;
+
+    let Ok(dir) = fs::read_dir(modules_dir) else {
+        return;
+    };
+
+    for entry in dir.flatten() {
+        let path = entry.path();
+        let Some(name) = entry.file_name().to_str().map(ToString::to_string) else {
+            continue;
+        };
+
+        let cached = index.remove(&name);
+        let id = cached
+            .as_ref()
+            .and_then(|(_, module)| module.get("id").cloned())
+            .unwrap_or_else(|| name.clone());
+        let Some(stamp) = module_stamp(&path, &id) else {
+            dirty |= cached.is_some();
+            continue;
+        };
+
+        let (stamp, module) = match cached {
+            Some((old, module)) if old == stamp => (stamp, module),
+            _ => {
+                dirty = true;
+                let Some(module) = module::read_module_entry(&path) else {
+                    continue;
+                };
+                // module.prop may carry a different id than we guessed
+                let stamp = match module.get("id") {
+                    Some(real_id) if *real_id != id => {
+                        module_stamp(&path, real_id).unwrap_or(stamp)
+                    }
+                    _ => stamp,
+                };
+                (stamp, module)
+            }
+        };
+
+        f(&module);
+        fresh.insert(name, (stamp, module));
+    }
+
+    // whatever is left in the old index was removed
+    if (dirty || !index.is_empty())
+        && let Err(e) = save_index(&fresh)
+    {
+        warn!("Failed to save module index: {e}");
+    }
+}
@@ -0,0 +1,379 @@
+//! Native module installation
+//!
+//! The zip central directory is read once. That single read gives
+//! module.prop, the uncompressed size and the entry list. Entries are then
+//! inflated in parallel, largest first. Every worker reads the archive through
+//! its own positional reader over the shared file and metadata. Files are
+//! written straight into the module directory with the owner, mode and
+//! SELinux label that `set_perm_recursive` in installer.sh applied afterwards.
+//! Modules without a customize.sh never reach the shell installer.
+
+use std::{
+    fs::{self, File, OpenOptions},
+    io::{self, Read, Seek, SeekFrom},
+    num::NonZeroUsize,
+    os::unix::fs::{FileExt, OpenOptionsExt, PermissionsExt, lchown, symlink},
+    path::{Path, PathBuf},
+    sync::{
+        Arc,
+        atomic::{AtomicUsize, Ordering},
+    },
+    thread,
+};
+
+use anyhow::{Context, Result, anyhow, ensure};
+use log::warn;
+use zip::ZipArchive;
+
+use crate::{
+    android::{
+        feature,
+        restorecon::{SYSTEM_CON, lsetfilecon, setsyscon},
+    },
+    defs,
+};
+
+const VENDOR_CON: &str = "u:object_r:vendor_file:s0";
+
+const S_IFMT: u32 = 0o170_000;
+const S_IFLNK: u32 = 0o120_000;
+
+/// Partitions moved out of $MODPATH/system when they are real directories
+const PARTITIONS: [&str; 4] = ["vendor", "system_ext", "product", "odm"];
+
+struct Perm {
+    gid: u32,
+    dir_mode: u32,
+    file_mode: u32,
+    con: &'static str,
+}
+
+const DEFAULT_PERM: Perm = Perm {
+    gid: 0,
+    dir_mode: 0o755,
+    file_mode: 0o644,
+    con: SYSTEM_CON,
+};
+
+const BIN_PERM: Perm = Perm {
+    gid: 2000,
+    dir_mode: 0o755,
+    file_mode: 0o755,
+    con: SYSTEM_CON,
+};
+
+const VENDOR_PERM: Perm = Perm {
+    gid: 2000,
+    dir_mode: 0o755,
+    file_mode: 0o755,
+    con: VENDOR_CON,
+};
+
+/// Same defaults as the `set_perm_recursive` calls of installer.sh
+fn default_perm(rel: &Path) -> &'static Perm {
+    if rel.starts_with("system/vendor") {
+        &VENDOR_PERM
+    } else if rel.starts_with("system/bin")
+        || rel.starts_with("system/xbin")
+        || rel.starts_with("system/system_ext/bin")
+    {
+        &BIN_PERM
+    } else {
+        &DEFAULT_PERM
+    }
+}
+
+fn apply_perm(path: &Path, perm: &Perm, is_dir: bool, is_symlink: bool) -> Result<()> {
+    lchown(path, Some(0), Some(perm.gid))
+        .with_context(|| format!("Failed to chown {}", path.display()))?;
+    if !is_symlink {
+        let mode = if is_dir {
+            perm.dir_mode
+        } else {
+            perm.file_mode
+        };
+        fs::set_permissions(path, fs::Permissions::from_mode(mode))
+            .with_context(|| format!("Failed to chmod {}", path.display()))?;
+    }
+    lsetfilecon(path, perm.con)
+}
+
+/// `Read + Seek` over a shared file with pread, so clones don't share a cursor
+#[derive(Clone)]
+struct ZipReader {
+    file: Arc<File>,
+    pos: u64,
+    len: u64,
+}
+
+impl Read for ZipReader {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        let n = self.file.read_at(buf, self.pos)?;
+        self.pos += n as u64;
+        Ok(n)
+    }
+}
+
+impl Seek for ZipReader {
+    fn seek(&mut self, pos: SeekFrom) -> io::Result<u64> {
+        let pos = match pos {
+            SeekFrom::Start(offset) => Some(offset),
+            SeekFrom::End(offset) => self.len.checked_add_signed(offset),
+            SeekFrom::Current(offset) => self.pos.checked_add_signed(offset),
+        };
+        let Some(pos) = pos else {
+            return Err(io::Error::new(
+                io::ErrorKind::InvalidInput,
+                "invalid seek to a negative position",
+            ));
+        };
+        self.pos = pos;
+        Ok(pos)
+    }
+}
+
+pub struct ModuleZip {
+    archive: ZipArchive<ZipReader>,
+    // entry indices, largest first so a big overlay doesn't start last
+    order: Vec<usize>,
+    size: u64,
+}
+
+impl ModuleZip {
+    pub fn open(path: &Path) -> Result<Self> {
+        let file =
+            File::open(path).with_context(|| format!("Failed to open {}", path.display()))?;
+        let len = file.metadata()?.len();
+        let mut archive = ZipArchive::new(ZipReader {
+            file: Arc::new(file),
+            pos: 0,
+            len,
+        })?;
+
+        let mut sizes = Vec::with_capacity(archive.len());
+        for i in 0..archive.len() {
+            // raw access only reads the central directory record
+            sizes.push((i, archive.by_index_raw(i)?.size()));
+        }
+        sizes.sort_unstable_by(|a, b| b.1.cmp(&a.1));
+
+        Ok(Self {
+            archive,
+            size: sizes.iter().map(|(_, size)| size).sum(),
+            order: sizes.into_iter().map(|(i, _)| i).collect(),
+        })
+    }
+
+    pub fn uncompressed_size(&self) -> u64 {
+        self.size
+    }
+
+    pub fn contains(&self, name: &str) -> bool {
+        self.archive.index_for_name(name).is_some()
+    }
+
+    pub fn read_file(&mut self, name: &str) -> Result<Option<Vec<u8>>> {
+        let Some(index) = self.archive.index_for_name(name) else {
+            return Ok(None);
+        };
+        let mut file = self.archive.by_index(index)?;
+        let mut buffer = Vec::with_capacity(usize::try_from(file.size()).unwrap_or_default());
+        file.read_to_end(&mut buffer)?;
+        Ok(Some(buffer))
+    }
+
+    /// Extract everything but META-INF into `dest`, which must exist
+    pub fn extract_to(&self, dest: &Path) -> Result<()> {
+        apply_perm(dest, &DEFAULT_PERM, true, false)?;
+
+        let next = AtomicUsize::new(0);
+        let jobs = thread::available_parallelism()
+            .map_or(1, NonZeroUsize::get)
+            .min(self.order.len());
+
+        thread::scope(|scope| {
+            let workers: Vec<_> = (0..jobs)
+                .map(|_| {
+                    let mut archive = self.archive.clone();
+                    let next = &next;
+                    scope.spawn(move || {
+                        while let Some(&i) = self.order.get(next.fetch_add(1, Ordering::Relaxed)) {
+                            extract_entry(&mut archive, i, dest)?;
+                        }
+                        Ok(())
+                    })
+                })
+                .collect();
+            workers.into_iter().try_for_each(|worker| {
+                worker
+                    .join()
+                    .unwrap_or_else(|_| Err(anyhow!("extract worker panicked")))
+            })
+        })
+    }
+}
+
+/// mkdir every missing parent of `rel`, refusing to walk through symlinks
+fn ensure_parents(dest: &Path, rel: &Path) -> Result<()> {
+    let Some(parent) = rel.parent() else {
+        return Ok(());
+    };
+    let mut rel_dir = PathBuf::new();
+    for component in parent.components() {
+        rel_dir.push(component);
+        let dir = dest.join(&rel_dir);
+        match fs::create_dir(&dir) {
+            Ok(()) => apply_perm(&dir, default_perm(&rel_dir), true, false)?,
+            Err(e) if e.kind() == io::ErrorKind::AlreadyExists => {
+                ensure!(
+                    fs::symlink_metadata(&dir)?.is_dir(),
+                    "{} is not a directory",
+                    dir.display()
+                );
+            }
+            Err(e) => {
+                return Err(e).with_context(|| format!("Failed to create {}", dir.display()));
+            }
+        }
+    }
+    Ok(())
+}
+
+fn extract_entry(archive: &mut ZipArchive<ZipReader>, index: usize, dest: &Path) -> Result<()> {
+    let mut file = archive.by_index(index)?;
+    let Some(rel) = file.enclosed_name() else {
+        warn!("Skip unsafe zip entry: {}", file.name());
+        return Ok(());
+    };
+    if rel.starts_with("META-INF") || rel.as_os_str().is_empty() {
+        return Ok(());
+    }
+
+    ensure_parents(dest, &rel)?;
+    let perm = default_perm(&rel);
+    let target = dest.join(&rel);
+
+    if file.is_dir() {
+        match fs::create_dir(&target) {
+            Err(e) if e.kind() != io::ErrorKind::AlreadyExists => {
+                return Err(e).with_context(|| format!("Failed to create {}", target.display()));
+            }
+            _ => {}
+        }
+        return apply_perm(&target, perm, true, false);
+    }
+
+    if file
+        .unix_mode()
+        .is_some_and(|mode| mode & S_IFMT == S_IFLNK)
+    {
+        let mut link = String::new();
+        file.read_to_string(&mut link)?;
+        let _ = fs::remove_file(&target);
+        symlink(&link, &target)
+            .with_context(|| format!("Failed to create symlink {}", target.display()))?;
+        return apply_perm(&target, perm, false, true);
+    }
+
+    // unzip -o, but never through a symlink another entry left there
+    let mut out = OpenOptions::new()
+        .write(true)
+        .create(true)
+        .truncate(true)
+        .mode(perm.file_mode)
+        .custom_flags(libc::O_NOFOLLOW)
+        .open(&target)
+        .with_context(|| format!("Failed to create {}", target.display()))?;
+    io::copy(&mut file, &mut out)
+        .with_context(|| format!("Failed to extract {}", target.display()))?;
+    drop(out);
+    apply_perm(&target, perm, false, false)
+}
+
+/// Whether customize.sh extracts the module by itself
+pub fn skips_unzip(customize: &[u8]) -> bool {
+    customize
+        .split(|&b| b == b'\n')
+        .any(|line| line == b"SKIPUNZIP=1")
+}
+
+fn print_title(line1: &str, line2: Option<&str>) {
+    let len = line1.len().max(line2.map_or(0, str::len)) + 2;
+    let bar = "*".repeat(len);
+    println!("{bar}");
+    println!(" {line1} ");
+    if let Some(line2) = line2 {
+        println!(" {line2} ");
+    }
+    println!("{bar}");
+}
+
+/// The parts of installer.sh that run before extraction
+pub fn print_header(name: &str, author: &str, managed_features: Option<&str>) {
+    print_title(name, Some(&format!("by {author}")));
+    print_title("Powered by KernelSU", None);
+
+    let Some(managed_features) = managed_features.filter(|f| !f.trim().is_empty()) else {
+        return;
+    };
+    println!("- Checking managed features: {managed_features}");
+    for feature in managed_features.split(',').map(str::trim) {
+        if feature.is_empty() {
+            continue;
+        }
+        match feature::feature_status(feature) {
+            Ok("unsupported") => {
+                println!("! WARNING: Feature '{feature}' is NOT SUPPORTED by kernel");
+                println!("!          This module may not work correctly!");
+            }
+            Ok("managed") => {
+                println!("! WARNING: Feature '{feature}' is already MANAGED by another module");
+                println!("!          Feature conflicts may occur!");
+            }
+            Ok(_) => println!("- Feature '{feature}' is supported and available"),
+            Err(_) => println!("! WARNING: Unable to check feature '{feature}' status"),
+        }
+    }
+}
+
+/// The parts of installer.sh that run after extraction
+pub fn finish(module_path: &Path, module_dir: &Path) -> Result<()> {
+    for partition in PARTITIONS {
+        let in_system = module_path.join("system").join(partition);
+        if !in_system.exists() {
+            continue;
+        }
+        let native = Path::new("/").join(partition);
+        if native.is_dir() && !native.is_symlink() {
+            println!("- Handle partition /{partition}");
+            fs::rename(&in_system, module_path.join(partition))
+                .with_context(|| format!("Failed to move {}", in_system.display()))?;
+            symlink(format!("../{partition}"), &in_system)?;
+            setsyscon(&in_system)?;
+        }
+    }
+
+    for marker in [defs::REMOVE_FILE_NAME, defs::DISABLE_FILE_NAME] {
+        let _ = fs::remove_file(module_dir.join(marker));
+    }
+
+    // things that don't belong to modules
+    let _ = fs::remove_file(module_path.join("system/placeholder"));
+    let _ = fs::remove_file(module_path.join("README.md"));
+    if let Ok(entries) = fs::read_dir(module_path) {
+        for entry in entries.flatten() {
+            if !entry.file_name().as_encoded_bytes().starts_with(b".git") {
+                continue;
+            }
+            let path = entry.path();
+            let _ = if entry.file_type().is_ok_and(|t| t.is_dir()) {
+                fs::remove_dir_all(&path)
+            } else {
+                fs::remove_file(&path)
+            };
+        }
+    }
+
+    println!("- Done");
+    Ok(())
+}
@@ -378,8 +378,8 @@ install_module() {
   # Check managed features
   check_managed_features $TMPDIR/module.prop
 
-  # Create mod paths
-  rm -rf $MODPATH
+  # Create mod paths, ksud may have extracted the module already
+  [ "$KSU_MODULE_EXTRACTED" = "true" ] || rm -rf $MODPATH
   mkdir -p $MODPATH
 
   if is_legacy_script; then
@@ -407,7 +407,9 @@ install_module() {
 
     unzip -o "$ZIPFILE" customize.sh -d $MODPATH >&2
 
-    if ! grep -q '^SKIPUNZIP=1$' $MODPATH/customize.sh 2>/dev/null; then
+    if [ "$KSU_MODULE_EXTRACTED" = "true" ]; then
+      ui_print "- Module files extracted"
+    elif ! grep -q '^SKIPUNZIP=1$' $MODPATH/customize.sh 2>/dev/null; then
       ui_print "- Extracting module files"
       unzip -o "$ZIPFILE" -x 'META-INF/*' -d $MODPATH >&2
 
@@ -196,6 +196,11 @@ pub fn get_install_script(
     Ok(install_script)
 }
 
+/// Whether installing a regular module goes through the metamodule's metainstall.sh
+pub fn has_metainstall_script(is_metamodule: bool) -> bool {
+    !is_metamodule && check_metamodule_script(defs::METAMODULE_METAINSTALL_SCRIPT).is_some()
+}
+
 /// Check if metamodule script exists and is ready to execute
 /// Returns None if metamodule doesn't exist, is disabled, or script is missing
 /// Returns Some(script_path) if script is ready to execute
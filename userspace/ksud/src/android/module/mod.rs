@@ -1,19 +1,23 @@
+mod index;
+mod install;
 pub mod metamodule;
 pub mod module_config;
+pub mod stage;
 
 #[cfg(all(target_os = "android", target_arch = "aarch64"))]
 use std::fs;
 #[cfg(unix)]
-use std::os::unix::{prelude::PermissionsExt, process::CommandExt};
+use std::os::unix::process::CommandExt;
 use std::{
-    collections::HashMap,
+    collections::{BTreeMap, HashMap},
     env::var as env_var,
-    fs::{File, Permissions, canonicalize, copy, remove_dir_all, rename, set_permissions},
-    io::Cursor,
+    fmt::Write as _,
+    fs::{File, copy, remove_dir_all, rename},
+    io::{Cursor, Write as _},
     path::{Path, PathBuf},
     process::Command,
     str::FromStr,
-    time::Duration,
+    time::{Duration, Instant},
 };
 
 use anyhow::{Context, Result, anyhow, bail, ensure};
@@ -25,18 +29,13 @@ use log::{debug, info, warn};
 use mlua::{Function, Lua, Result as LuaResult, Table};
 use regex_lite::Regex;
 use wait_timeout::ChildExt;
-use zip_extensions::zip_extract_file_to_memory;
 
 use crate::{
     android::{
         ksucalls,
         module::ModuleType::{Active, All},
-        restorecon::{restore_syscon, setsyscon},
-        sepolicy,
-        utils::{
-            ensure_clean_dir, ensure_dir_exists, ensure_file_exists, get_zip_uncompressed_size,
-            getprop, switch_cgroups,
-        },
+        restorecon::setsyscon,
+        utils::{ensure_clean_dir, ensure_dir_exists, ensure_file_exists, getprop, switch_cgroups},
     },
     assets, defs,
     defs::{MODULE_DIR, MODULE_UPDATE_DIR, UPDATE_FILE_NAME},
@@ -88,7 +87,7 @@ pub fn get_common_script_envs() -> Vec<(&'static str, String)> {
     ]
 }
 
-fn exec_install_script(module_file: &str, is_metamodule: bool) -> Result<()> {
+fn exec_install_script(module_file: &str, is_metamodule: bool, extracted: bool) -> Result<()> {
     let realpath = std::fs::canonicalize(module_file)
         .with_context(|| format!("realpath: {module_file} failed"))?;
 
@@ -101,6 +100,7 @@ fn exec_install_script(module_file: &str, is_metamodule: bool) -> Result<()> {
         .envs(get_common_script_envs())
         .env("OUTFD", "1")
         .env("ZIPFILE", realpath)
+        .env("KSU_MODULE_EXTRACTED", extracted.to_string())
         .status()?;
     ensure!(result.success(), "Failed to install module script");
     Ok(())
@@ -154,35 +154,30 @@ pub fn foreach_module(
     Ok(())
 }
 
-fn foreach_active_module(f: impl FnMut(&Path) -> Result<()>) -> Result<()> {
+pub(crate) fn foreach_active_module(f: impl FnMut(&Path) -> Result<()>) -> Result<()> {
     foreach_module(Active, f)
 }
 
-pub fn load_sepolicy_rule() -> Result<()> {
-    foreach_active_module(|path| {
-        let rule_file = path.join("sepolicy.rule");
-        if !rule_file.exists() {
-            return Ok(());
-        }
-        info!("load policy: {}", &rule_file.display());
+pub fn exec_script<T: AsRef<Path>>(path: T, wait: bool, timeout: Duration) -> Result<()> {
+    info!("exec {}", path.as_ref().display());
 
-        if sepolicy::apply_file(&rule_file).is_err() {
-            warn!("Failed to load sepolicy.rule for {}", &rule_file.display());
+    let mut command = script_command(path.as_ref());
+    let result = {
+        if wait {
+            command.spawn()?.wait_timeout(timeout).map(|_| ())
+        } else {
+            command.spawn().map(|_| ())
         }
-        Ok(())
-    })?;
-
-    Ok(())
+    };
+    result.map_err(|e| anyhow!("Failed to exec {}: {e}", path.as_ref().display()))
 }
 
-pub fn exec_script<T: AsRef<Path>>(path: T, wait: bool, timeout: Duration) -> Result<()> {
-    info!("exec {}", path.as_ref().display());
-
-    let is_module_script = path.as_ref().starts_with(defs::MODULE_DIR);
+/// Build the busybox sh command used to run a module or common script
+pub fn script_command(path: &Path) -> Command {
+    let is_module_script = path.starts_with(defs::MODULE_DIR);
     // Extract module_id from path if it matches /data/adb/modules/{id}/...
     let module_id = if is_module_script {
-        path.as_ref()
-            .strip_prefix(defs::MODULE_DIR)
+        path.strip_prefix(defs::MODULE_DIR)
             .ok()
             .and_then(|p| p.components().next())
             .and_then(|c| c.as_os_str().to_str())
@@ -202,7 +197,7 @@ pub fn exec_script<T: AsRef<Path>>(path: T, wait: bool, timeout: Duration) -> Re
             Err(e) => {
                 warn!(
                     "Invalid module ID '{id}' extracted from script path '{}': {e}",
-                    path.as_ref().display(),
+                    path.display(),
                 );
                 None
             }
@@ -211,62 +206,40 @@ pub fn exec_script<T: AsRef<Path>>(path: T, wait: bool, timeout: Duration) -> Re
     if is_module_script && module_id.is_none() {
         debug!(
             "Failed to extract module_id from script path '{}'. Script will run without KSU_MODULE environment variable.",
-            path.as_ref().display()
+            path.display()
         );
     }
 
-    let mut command = &mut Command::new(assets::BUSYBOX_PATH);
+    let mut command = Command::new(assets::BUSYBOX_PATH);
     #[cfg(unix)]
     {
-        command = command.process_group(0);
-        command = unsafe {
+        command.process_group(0);
+        unsafe {
             command.pre_exec(|| {
                 // ignore the error?
                 switch_cgroups();
                 Ok(())
-            })
-        };
+            });
+        }
     }
-    command = command
-        .current_dir(path.as_ref().parent().unwrap())
+    command
+        .current_dir(path.parent().unwrap())
         .arg("sh")
-        .arg(path.as_ref())
+        .arg(path)
         .envs(get_common_script_envs());
 
     // Set KSU_MODULE environment variable if module_id was validated successfully
     if let Some(id) = validated_module_id {
-        command = command.env("KSU_MODULE", id);
+        command.env("KSU_MODULE", id);
     }
 
-    let result = {
-        if wait {
-            command.spawn()?.wait_timeout(timeout).map(|_| ())
-        } else {
-            command.spawn().map(|_| ())
-        }
-    };
-    result.map_err(|e| anyhow!("Failed to exec {}: {e}", path.as_ref().display()))
+    command
 }
 
 pub fn exec_stage_script(stage: &str, block: bool) -> Result<()> {
-    let metamodule_dir = metamodule::get_metamodule_path().and_then(|path| canonicalize(path).ok());
-
-    foreach_active_module(|module| {
-        if metamodule_dir.as_ref().is_some_and(|meta_dir| {
-            canonicalize(module)
-                .map(|resolved| resolved == *meta_dir)
-                .unwrap_or(false)
-        }) {
-            return Ok(());
-        }
-
-        let script_path = module.join(format!("{stage}.sh"));
-        if !script_path.exists() {
-            return Ok(());
-        }
-
-        exec_script(&script_path, block, defs::EXEC_STAGE_TIMEOUT)
-    })?;
+    for script in stage::collect_stage_scripts(stage)? {
+        exec_script(&script.path, block, defs::EXEC_STAGE_TIMEOUT)?;
+    }
 
     Ok(())
 }
@@ -437,25 +410,77 @@ pub fn run_lua(id: &str, function: &str, on_each_module: bool, _wait: bool) -> m
     Ok(())
 }
 
+/// Merged system.prop of all active modules, handed to resetprop in one go
+const SYSTEM_PROP_BATCH: &str = concatcp!(defs::WORKING_DIR, ".system_prop");
+
+/// Parse a system.prop the way `resetprop --file` does: `key=value` lines,
+/// `#` comments, blank lines ignored
+fn parse_system_prop(content: &str, props: &mut BTreeMap<String, String>) {
+    for line in content.lines() {
+        let line = line.trim();
+        if line.is_empty() || line.starts_with('#') {
+            continue;
+        }
+        let Some((key, value)) = line.split_once('=') else {
+            continue;
+        };
+        let key = key.trim();
+        if !key.is_empty() {
+            props.insert(key.to_string(), value.trim().to_string());
+        }
+    }
+}
+
 pub fn load_system_prop() -> Result<()> {
+    let start = Instant::now();
+
+    let mut files = Vec::new();
     foreach_active_module(|module| {
         let system_prop = module.join("system.prop");
-        if !system_prop.exists() {
-            return Ok(());
+        if system_prop.exists() {
+            files.push(system_prop);
         }
-        info!("load {} system.prop", module.display());
-
-        // resetprop -n --file system.prop
-        Command::new(assets::RESETPROP_PATH)
-            .arg("-n")
-            .arg("--file")
-            .arg(&system_prop)
-            .status()
-            .with_context(|| format!("Failed to exec {}", system_prop.display()))?;
-
         Ok(())
     })?;
+    if files.is_empty() {
+        return Ok(());
+    }
 
+    // modules in id order, a later module overrides an earlier one
+    files.sort();
+    let mut props = BTreeMap::new();
+    for system_prop in &files {
+        info!("load {}", system_prop.display());
+        match std::fs::read_to_string(system_prop) {
+            Ok(content) => parse_system_prop(&content, &mut props),
+            Err(e) => warn!("Failed to read {}: {e}", system_prop.display()),
+        }
+    }
+
+    let mut batch = String::new();
+    for (key, value) in &props {
+        let _ = writeln!(batch, "{key}={value}");
+    }
+    std::fs::write(SYSTEM_PROP_BATCH, batch)
+        .with_context(|| format!("Failed to write {SYSTEM_PROP_BATCH}"))?;
+
+    // resetprop -n --file, once for every module
+    let status = Command::new(assets::RESETPROP_PATH)
+        .arg("-n")
+        .arg("--file")
+        .arg(SYSTEM_PROP_BATCH)
+        .status()
+        .with_context(|| format!("Failed to exec {}", assets::RESETPROP_PATH))?;
+    if !status.success() {
+        warn!("resetprop exited with {status}");
+    }
+
+    info!(
+        "system.prop: set {} properties from {} modules in {} ms",
+        props.len(),
+        files.len(),
+        start.elapsed().as_millis()
+    );
     Ok(())
 }
 
@@ -566,11 +591,12 @@ fn install_module_to_system(zip: &str) -> Result<()> {
     ensure_dir_exists(defs::BINARY_DIR).with_context(|| "Failed to create bin dir")?;
 
     // read the module_id from zip, if failed it will return early.
-    let mut buffer: Vec<u8> = Vec::new();
-    let entry_path = PathBuf::from_str("module.prop")?;
     let zip_path = PathBuf::from_str(zip)?;
     let zip_path = zip_path.canonicalize()?;
-    zip_extract_file_to_memory(&zip_path, &entry_path, &mut buffer)?;
+    let mut module_zip = install::ModuleZip::open(&zip_path)?;
+    let Some(buffer) = module_zip.read_file("module.prop")? else {
+        bail!("module.prop not found in zip!");
+    };
 
     let mut module_prop = HashMap::new();
     PropertiesIter::new_with_encoding(Cursor::new(buffer), encoding_rs::UTF_8).read_into(
@@ -642,7 +668,7 @@ fn install_module_to_system(zip: &str) -> Result<()> {
         }
     }
 
-    let zip_uncompressed_size = get_zip_uncompressed_size(zip)?;
+    let zip_uncompressed_size = module_zip.uncompressed_size();
     info!(
         "zip uncompressed size: {}",
         humansize::format_size(zip_uncompressed_size, humansize::DECIMAL)
@@ -652,34 +678,45 @@ fn install_module_to_system(zip: &str) -> Result<()> {
         humansize::format_size(zip_uncompressed_size, humansize::DECIMAL)
     );
 
+    // Only customize.sh, legacy install.sh and metainstall.sh need the shell
+    // installer. Unless customize.sh extracts by itself, files are already in
+    // place when it runs.
+    let customize = module_zip.read_file("customize.sh")?;
+    let legacy = module_zip.contains("install.sh");
+    let run_script =
+        customize.is_some() || legacy || metamodule::has_metainstall_script(is_metamodule);
+    let extract = !legacy && !customize.as_deref().is_some_and(install::skips_unzip);
+
     // Ensure module directory exists and set SELinux context
     ensure_dir_exists(defs::MODULE_UPDATE_DIR)?;
     setsyscon(defs::MODULE_UPDATE_DIR)?;
 
+    if !run_script {
+        install::print_header(
+            module_prop.get("name").map_or(module_id, String::as_str),
+            module_prop.get("author").map_or("", String::as_str),
+            module_prop.get("managedFeatures").map(String::as_str),
+        );
+    }
+
     // Prepare target directory
     println!("- Installing to {}", updated_dir.display());
     ensure_clean_dir(&updated_dir)?;
     info!("target dir: {}", updated_dir.display());
 
-    // Extract zip to target directory
-    println!("- Extracting module files");
-    let file = File::open(zip)?;
-    let mut archive = zip::ZipArchive::new(file)?;
-    archive.extract(&updated_dir)?;
-
-    // Set permission and selinux context for $MOD/system
-    let module_system_dir = updated_dir.join("system");
-    if module_system_dir.exists() {
-        #[cfg(unix)]
-        set_permissions(&module_system_dir, Permissions::from_mode(0o755))?;
-        restore_syscon(&module_system_dir)?;
+    if extract {
+        println!("- Extracting module files");
+        module_zip.extract_to(&updated_dir)?;
     }
 
-    // Execute install script
-    println!("- Running module installer");
-    exec_install_script(zip, is_metamodule)?;
-
     let module_dir = Path::new(MODULE_DIR).join(module_id);
+    if run_script {
+        println!("- Running module installer");
+        exec_install_script(zip, is_metamodule, extract)?;
+    } else {
+        install::finish(&updated_dir, &module_dir)?;
+    }
+
     ensure_dir_exists(&module_dir)?;
     copy(
         updated_dir.join("module.prop"),
@@ -838,101 +875,105 @@ pub fn read_module_prop(module_path: &Path) -> Result<HashMap<String, String>> {
     Ok(prop_map)
 }
 
-fn list_module(path: &str) -> Vec<HashMap<String, String>> {
-    // Load all module configs once to minimize I/O overhead
-    let all_configs = match module_config::get_all_module_configs() {
-        Ok(configs) => configs,
+/// Build the `module list` entry of one module directory, None if it isn't
+/// a module
+pub(crate) fn read_module_entry(path: &Path) -> Option<HashMap<String, String>> {
+    debug!("path: {}", path.display());
+
+    if !path.join("module.prop").exists() {
+        return None;
+    }
+
+    let mut module_prop_map = match read_module_prop(path) {
+        Ok(prop) => prop,
         Err(e) => {
-            warn!("Failed to load module configs: {e}");
-            HashMap::new()
+            warn!("Failed to read module.prop for {}: {e}", path.display());
+            return None;
         }
     };
 
-    // first check enabled modules
-    let dir = std::fs::read_dir(path);
-    let Ok(dir) = dir else {
-        return Vec::new();
-    };
-
-    let mut modules: Vec<HashMap<String, String>> = Vec::new();
-
-    for entry in dir.flatten() {
-        let path = entry.path();
-        info!("path: {}", path.display());
-
-        if !path.join("module.prop").exists() {
-            continue;
+    // If id is missing or empty, use directory name as fallback
+    if !module_prop_map.contains_key("id") || module_prop_map["id"].is_empty() {
+        if let Some(id) = path.file_name().and_then(|name| name.to_str()) {
+            info!("Use dir name as module id: {id}");
+            module_prop_map.insert("id".to_owned(), id.to_owned());
+        } else {
+            info!("Failed to get module id from dir name");
+            return None;
         }
+    }
 
-        let mut module_prop_map = match read_module_prop(&path) {
-            Ok(prop) => prop,
-            Err(e) => {
-                warn!("Failed to read module.prop for {}: {e}", path.display());
-                continue;
-            }
-        };
+    // Add enabled, update, remove, web, action flags
+    let enabled = !path.join(defs::DISABLE_FILE_NAME).exists();
+    let update = path.join(defs::UPDATE_FILE_NAME).exists();
+    let remove = path.join(defs::REMOVE_FILE_NAME).exists();
+    let web = path.join(defs::MODULE_WEB_DIR).exists();
+    let action = path.join(defs::MODULE_ACTION_SH).exists();
+    let need_mount = path.join("system").exists() && !path.join("skip_mount").exists();
+
+    module_prop_map.insert("enabled".to_owned(), enabled.to_string());
+    module_prop_map.insert("update".to_owned(), update.to_string());
+    module_prop_map.insert("remove".to_owned(), remove.to_string());
+    module_prop_map.insert("web".to_owned(), web.to_string());
+    module_prop_map.insert("action".to_owned(), action.to_string());
+    module_prop_map.insert("mount".to_owned(), need_mount.to_string());
+
+    // Apply module config overrides and extract managed features
+    let module_id = module_prop_map["id"].clone();
+    let config = if Path::new(defs::MODULE_CONFIG_DIR).join(&module_id).is_dir() {
+        module_config::merge_configs(&module_id).unwrap_or_else(|e| {
+            warn!("Failed to load config for module '{module_id}': {e}");
+            HashMap::new()
+        })
+    } else {
+        HashMap::new()
+    };
 
-        // If id is missing or empty, use directory name as fallback
-        if !module_prop_map.contains_key("id") || module_prop_map["id"].is_empty() {
-            if let Some(id) = entry.file_name().to_str() {
-                info!("Use dir name as module id: {id}");
-                module_prop_map.insert("id".to_owned(), id.to_owned());
+    // Apply override.description
+    if let Some(desc) = config.get("override.description") {
+        module_prop_map.insert("description".to_owned(), desc.clone());
+    }
+
+    // Extract managed features from manage.* config entries
+    let managed_features: Vec<String> = config
+        .iter()
+        .filter_map(|(k, v)| {
+            if k.starts_with("manage.") && module_config::parse_bool_config(v) {
+                k.strip_prefix("manage.")
+                    .map(std::string::ToString::to_string)
             } else {
-                info!("Failed to get module id from dir name");
-                continue;
+                None
             }
-        }
+        })
+        .collect();
 
-        // Add enabled, update, remove, web, action flags
-        let enabled = !path.join(defs::DISABLE_FILE_NAME).exists();
-        let update = path.join(defs::UPDATE_FILE_NAME).exists();
-        let remove = path.join(defs::REMOVE_FILE_NAME).exists();
-        let web = path.join(defs::MODULE_WEB_DIR).exists();
-        let action = path.join(defs::MODULE_ACTION_SH).exists();
-        let need_mount = path.join("system").exists() && !path.join("skip_mount").exists();
-
-        module_prop_map.insert("enabled".to_owned(), enabled.to_string());
-        module_prop_map.insert("update".to_owned(), update.to_string());
-        module_prop_map.insert("remove".to_owned(), remove.to_string());
-        module_prop_map.insert("web".to_owned(), web.to_string());
-        module_prop_map.insert("action".to_owned(), action.to_string());
-        module_prop_map.insert("mount".to_owned(), need_mount.to_string());
-
-        // Apply module config overrides and extract managed features
-        if let Some(module_id) = module_prop_map.get("id")
-            && let Some(config) = all_configs.get(module_id.as_str())
-        {
-            // Apply override.description
-            if let Some(desc) = config.get("override.description") {
-                module_prop_map.insert("description".to_owned(), desc.clone());
-            }
+    if !managed_features.is_empty() {
+        module_prop_map.insert("managedFeatures".to_owned(), managed_features.join(","));
+    }
 
-            // Extract managed features from manage.* config entries
-            let managed_features: Vec<String> = config
-                .iter()
-                .filter_map(|(k, v)| {
-                    if k.starts_with("manage.") && module_config::parse_bool_config(v) {
-                        k.strip_prefix("manage.")
-                            .map(std::string::ToString::to_string)
-                    } else {
-                        None
-                    }
-                })
-                .collect();
+    Some(module_prop_map)
+}
 
-            if !managed_features.is_empty() {
-                module_prop_map.insert("managedFeatures".to_owned(), managed_features.join(","));
+pub fn list_modules(stream: bool) -> Result<()> {
+    if stream {
+        // one JSON object per line, printed as soon as it is known. The
+        // manager may close the pipe early, so a write error ends the listing
+        let mut out = std::io::stdout().lock();
+        let mut result = Ok(());
+        index::for_each_module(Path::new(defs::MODULE_DIR), |module| {
+            if result.is_ok() {
+                result = serde_json::to_string(module)
+                    .map_err(anyhow::Error::from)
+                    .and_then(|line| Ok(writeln!(out, "{line}")?));
             }
-        }
-
-        modules.push(module_prop_map);
+        });
+        return result;
     }
 
-    modules
-}
-
-pub fn list_modules() -> Result<()> {
-    let modules = list_module(defs::MODULE_DIR);
+    let mut modules = Vec::new();
+    index::for_each_module(Path::new(defs::MODULE_DIR), |module| {
+        modules.push(module.clone());
+    });
     println!("{}", serde_json::to_string_pretty(&modules)?);
     Ok(())
 }
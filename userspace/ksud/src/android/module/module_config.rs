@@ -360,45 +360,6 @@ pub fn merge_configs(module_id: &str) -> Result<HashMap<String, String>> {
     Ok(merged)
 }
 
-/// Get all module configs (for iteration)
-/// Loads all configs in a single pass to minimize I/O overhead
-pub fn get_all_module_configs() -> Result<HashMap<String, HashMap<String, String>>> {
-    let config_root = Path::new(defs::MODULE_CONFIG_DIR);
-
-    if !config_root.exists() {
-        return Ok(HashMap::new());
-    }
-
-    let mut all_configs = HashMap::new();
-
-    for entry in fs::read_dir(config_root)
-        .with_context(|| format!("Failed to read config directory: {}", config_root.display()))?
-    {
-        let entry = entry?;
-        let path = entry.path();
-
-        if !path.is_dir() {
-            continue;
-        }
-
-        if let Some(module_id) = path.file_name().and_then(|n| n.to_str()) {
-            match merge_configs(module_id) {
-                Ok(config) => {
-                    if !config.is_empty() {
-                        all_configs.insert(module_id.to_string(), config);
-                    }
-                }
-                Err(e) => {
-                    warn!("Failed to load config for module '{module_id}': {e}");
-                    // Continue processing other modules
-                }
-            }
-        }
-    }
-
-    Ok(all_configs)
-}
-
 /// Clear all temporary configs (called during post-fs-data)
 pub fn clear_all_temp_configs() -> Result<()> {
     let config_root = Path::new(defs::MODULE_CONFIG_DIR);
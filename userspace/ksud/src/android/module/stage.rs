@@ -0,0 +1,261 @@
+//! Stage script scheduling
+//!
+//! Blocking stages (post-fs-data) hold init until they return, so module
+//! scripts run in parallel up to the CPU count instead of one after another.
+//! A module can ask to run after others by listing their ids in the
+//! `runAfter` key of its module.prop. The whole stage is bounded by a
+//! deadline: when it passes, the scripts not started yet are all started
+//! detached at once and init is released, so `runAfter` ordering is not kept
+//! past the deadline. Every script's wall time goes to a per-stage report in
+//! the log directory.
+
+use std::{
+    collections::{HashMap, VecDeque},
+    fmt::Write as _,
+    fs::canonicalize,
+    num::NonZeroUsize,
+    path::{Path, PathBuf},
+    sync::mpsc::{self, RecvTimeoutError},
+    thread,
+    time::{Duration, Instant},
+};
+
+use anyhow::Result;
+use log::{info, warn};
+use wait_timeout::ChildExt;
+
+use crate::{
+    android::{
+        boot_timeline,
+        module::{self, metamodule},
+    },
+    defs,
+};
+
+/// module.prop key: comma separated ids whose stage script must finish first
+const RUN_AFTER_PROP: &str = "runAfter";
+
+pub struct StageScript {
+    pub id: String,
+    pub path: PathBuf,
+    after: Vec<String>,
+}
+
+struct Record {
+    id: String,
+    elapsed: Duration,
+    result: String,
+}
+
+/// Collect `{stage}.sh` of every active module, the metamodule excluded
+pub fn collect_stage_scripts(stage: &str) -> Result<Vec<StageScript>> {
+    let metamodule_dir = metamodule::get_metamodule_path().and_then(|path| canonicalize(path).ok());
+    let mut scripts = Vec::new();
+
+    module::foreach_active_module(|module| {
+        if metamodule_dir.as_ref().is_some_and(|meta_dir| {
+            canonicalize(module)
+                .map(|resolved| resolved == *meta_dir)
+                .unwrap_or(false)
+        }) {
+            return Ok(());
+        }
+
+        let script_path = module.join(format!("{stage}.sh"));
+        if !script_path.exists() {
+            return Ok(());
+        }
+
+        let id = module
+            .file_name()
+            .and_then(|name| name.to_str())
+            .unwrap_or_default()
+            .to_string();
+        let after = module::read_module_prop(module)
+            .ok()
+            .and_then(|props| props.get(RUN_AFTER_PROP).cloned())
+            .map(|value| {
+                value
+                    .split(',')
+                    .map(str::trim)
+                    .filter(|dep| !dep.is_empty() && *dep != id)
+                    .map(ToString::to_string)
+                    .collect()
+            })
+            .unwrap_or_default();
+
+        scripts.push(StageScript {
+            id,
+            path: script_path,
+            after,
+        });
+        Ok(())
+    })?;
+
+    Ok(scripts)
+}
+
+/// Run the module scripts of a blocking stage in parallel, respecting
+/// `runAfter` ordering, and return once all finished or `deadline` passed.
+pub fn exec_stage_parallel(stage: &str, deadline: Instant) -> Result<()> {
+    let scripts = collect_stage_scripts(stage)?;
+    if scripts.is_empty() {
+        return Ok(());
+    }
+
+    let index: HashMap<&str, usize> = scripts
+        .iter()
+        .enumerate()
+        .map(|(i, script)| (script.id.as_str(), i))
+        .collect();
+
+    // Only modules running a script in this stage take part in ordering
+    let mut waiting_on = vec![0usize; scripts.len()];
+    let mut dependents = vec![Vec::new(); scripts.len()];
+    for (i, script) in scripts.iter().enumerate() {
+        for dep in &script.after {
+            if let Some(&d) = index.get(dep.as_str()) {
+                waiting_on[i] += 1;
+                dependents[d].push(i);
+            }
+        }
+    }
+
+    let mut ready: VecDeque<usize> = (0..scripts.len()).filter(|&i| waiting_on[i] == 0).collect();
+    let mut started = vec![false; scripts.len()];
+    let mut finished = vec![false; scripts.len()];
+    let mut records = Vec::with_capacity(scripts.len());
+    let jobs = thread::available_parallelism().map_or(1, NonZeroUsize::get);
+    let (tx, rx) = mpsc::channel();
+    let mut running = 0;
+
+    info!(
+        "{stage}: running {} module scripts, {jobs} at a time",
+        scripts.len()
+    );
+
+    'schedule: loop {
+        while running < jobs
+            && let Some(i) = ready.pop_front()
+        {
+            if started[i] {
+                continue;
+            }
+            let left = deadline.saturating_duration_since(Instant::now());
+            if left.is_zero() {
+                // the rest is started detached below
+                break 'schedule;
+            }
+            started[i] = true;
+            running += 1;
+            let timeout = left.min(defs::EXEC_STAGE_TIMEOUT);
+            spawn_script(stage, i, &scripts[i], timeout, tx.clone());
+        }
+
+        if running == 0 {
+            // Nothing runnable left: either done or the rest is a cycle
+            let Some(i) = (0..scripts.len()).find(|&i| !started[i]) else {
+                break;
+            };
+            warn!(
+                "{stage}: {} is part of a runAfter cycle, running it anyway",
+                scripts[i].id
+            );
+            ready.push_back(i);
+            continue;
+        }
+
+        let left = deadline.saturating_duration_since(Instant::now());
+        match rx.recv_timeout(left) {
+            Ok((i, record)) => {
+                running -= 1;
+                finished[i] = true;
+                records.push(record);
+                for &d in &dependents[i] {
+                    waiting_on[d] -= 1;
+                    if waiting_on[d] == 0 {
+                        ready.push_back(d);
+                    }
+                }
+            }
+            Err(RecvTimeoutError::Timeout | RecvTimeoutError::Disconnected) => break,
+        }
+    }
+
+    for (i, script) in scripts.iter().enumerate() {
+        if finished[i] {
+            continue;
+        }
+        let result = if started[i] {
+            "running at deadline".to_string()
+        } else {
+            // don't drop it, just stop holding up the boot for it
+            match module::script_command(&script.path).spawn() {
+                Ok(_) => "detached at deadline".to_string(),
+                Err(e) => format!("error ({e})"),
+            }
+        };
+        warn!("{stage}: {}: {result}", script.id);
+        records.push(Record {
+            id: script.id.clone(),
+            elapsed: Duration::ZERO,
+            result,
+        });
+    }
+
+    write_report(stage, &records);
+    Ok(())
+}
+
+fn spawn_script(
+    stage: &str,
+    idx: usize,
+    script: &StageScript,
+    timeout: Duration,
+    tx: mpsc::Sender<(usize, Record)>,
+) {
+    let id = script.id.clone();
+    let path = script.path.clone();
+    let span_name = format!("{stage}: {id}");
+
+    thread::spawn(move || {
+        info!("exec {}", path.display());
+        let _span = boot_timeline::Span::new(boot_timeline::CAT_MODULE, span_name);
+        let start = Instant::now();
+        let result = match module::script_command(&path).spawn() {
+            Ok(mut child) => match child.wait_timeout(timeout) {
+                Ok(Some(status)) if status.success() => "ok".to_string(),
+                Ok(Some(status)) => format!("failed ({status})"),
+                Ok(None) => "timeout".to_string(),
+                Err(e) => format!("error ({e})"),
+            },
+            Err(e) => format!("error ({e})"),
+        };
+        let _ = tx.send((
+            idx,
+            Record {
+                id,
+                elapsed: start.elapsed(),
+                result,
+            },
+        ));
+    });
+}
+
+fn write_report(stage: &str, records: &[Record]) {
+    let mut content = String::new();
+    for record in records {
+        let _ = writeln!(
+            content,
+            "{}\t{}ms\t{}",
+            record.id,
+            record.elapsed.as_millis(),
+            record.result
+        );
+    }
+
+    let report = Path::new(defs::LOG_DIR).join(format!("{stage}.report"));
+    if let Err(e) = std::fs::write(&report, content) {
+        warn!("Failed to write {}: {e}", report.display());
+    }
+}
@@ -1,6 +1,6 @@
 use std::path::Path;
 
-use anyhow::{Context, Result};
+use anyhow::Result;
 
 use crate::{
     android::{sepolicy, utils::ensure_dir_exists},
@@ -57,27 +57,3 @@ pub fn list_templates() -> Result<()> {
     }
     Ok(())
 }
-
-pub fn apply_sepolies() -> Result<()> {
-    let path = Path::new(defs::PROFILE_SELINUX_DIR);
-    if !path.exists() {
-        log::info!("profile sepolicy dir not exists.");
-        return Ok(());
-    }
-
-    let sepolicies =
-        std::fs::read_dir(path).with_context(|| "profile sepolicy dir open failed.".to_string())?;
-    for sepolicy in sepolicies {
-        let Ok(sepolicy) = sepolicy else {
-            log::info!("profile sepolicy dir read failed.");
-            continue;
-        };
-        let sepolicy = sepolicy.path();
-        if sepolicy::apply_file(&sepolicy).is_ok() {
-            log::info!("profile sepolicy applied: {}", sepolicy.display());
-        } else {
-            log::info!("profile sepolicy apply failed: {}", sepolicy.display());
-        }
-    }
-    Ok(())
-}
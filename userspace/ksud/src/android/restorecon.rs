@@ -1,16 +1,32 @@
-use std::path::Path;
+use std::{
+    ffi::{CStr, OsStr},
+    fs,
+    os::unix::{
+        ffi::{OsStrExt, OsStringExt},
+        fs::MetadataExt,
+    },
+    path::{Path, PathBuf},
+    sync::atomic::{AtomicUsize, Ordering},
+    thread,
+};
 
-use anyhow::{Context, Ok, Result};
+use anyhow::{Context, Ok, Result, anyhow};
 use extattr::{Flags as XattrFlags, lsetxattr};
-use jwalk::{Parallelism::Serial, WalkDir};
 
-use crate::defs;
+use crate::{android::utils, defs};
 
 pub const SYSTEM_CON: &str = "u:object_r:system_file:s0";
 pub const ADB_CON: &str = "u:object_r:adb_data_file:s0";
 pub const UNLABEL_CON: &str = "u:object_r:unlabeled:s0";
 
 const SELINUX_XATTR: &str = "security.selinux";
+const SELINUX_XATTR_C: &CStr = c"security.selinux";
+// set on a module root once its tree is labeled, holds the module.prop
+// identity and the build fingerprint
+const LABEL_STAMP_XATTR: &str = "trusted.ksu.labeled";
+// the mounted parts of a module, walked every boot: scripts may add files
+// there at any time
+const OVERLAY_DIRS: [&str; 5] = ["system", "vendor", "product", "system_ext", "odm"];
 
 pub fn lsetfilecon<P: AsRef<Path>>(path: P, con: &str) -> Result<()> {
     lsetxattr(&path, SELINUX_XATTR, con, XattrFlags::empty()).with_context(|| {
@@ -22,42 +38,146 @@ pub fn lsetfilecon<P: AsRef<Path>>(path: P, con: &str) -> Result<()> {
     Ok(())
 }
 
-pub fn lgetfilecon<P: AsRef<Path>>(path: P) -> Result<String> {
-    let con = extattr::lgetxattr(&path, SELINUX_XATTR).with_context(|| {
-        format!(
-            "Failed to get SELinux context for {}",
-            path.as_ref().display()
+pub fn setsyscon<P: AsRef<Path>>(path: P) -> Result<()> {
+    lsetfilecon(path, SYSTEM_CON)
+}
+
+/// Read the raw label of a NUL terminated path into `buf`, no allocation
+fn is_unlabeled(path: &CStr, buf: &mut [u8]) -> bool {
+    let len = unsafe {
+        libc::lgetxattr(
+            path.as_ptr(),
+            SELINUX_XATTR_C.as_ptr(),
+            buf.as_mut_ptr().cast(),
+            buf.len(),
         )
-    })?;
-    let con = String::from_utf8_lossy(&con);
-    Ok(con.to_string())
+    };
+    // unreadable or longer than any unlabeled context: leave it alone
+    if len < 0 {
+        return false;
+    }
+    let con = &buf[..len as usize];
+    let con = con.strip_suffix(b"\0").unwrap_or(con);
+    con.is_empty() || con == UNLABEL_CON.as_bytes()
 }
 
-pub fn setsyscon<P: AsRef<Path>>(path: P) -> Result<()> {
-    lsetfilecon(path, SYSTEM_CON)
+/// `path` is reused across the walk and never holds the NUL itself
+fn relabel_if_unlabeled(path: &mut Vec<u8>, con_buf: &mut [u8]) -> Result<()> {
+    path.push(0);
+    let unlabeled =
+        CStr::from_bytes_with_nul(path).is_ok_and(|c_path| is_unlabeled(c_path, con_buf));
+    path.pop();
+    if unlabeled {
+        lsetfilecon(OsStr::from_bytes(path), SYSTEM_CON)?;
+    }
+    Ok(())
 }
 
-pub fn restore_syscon<P: AsRef<Path>>(dir: P) -> Result<()> {
-    for dir_entry in WalkDir::new(dir).parallelism(Serial) {
-        if let Some(path) = dir_entry.ok().map(|dir_entry| dir_entry.path()) {
-            setsyscon(&path)?;
-        }
+fn relabel_tree(path: &mut Vec<u8>, con_buf: &mut [u8]) -> Result<()> {
+    relabel_if_unlabeled(path, con_buf)?;
+
+    let Some(dir) = fs::read_dir(OsStr::from_bytes(path)).ok() else {
+        return Ok(());
+    };
+    for entry in dir.flatten() {
+        let len = path.len();
+        path.push(b'/');
+        path.extend_from_slice(entry.file_name().as_bytes());
+        // d_type, symlinks are not followed
+        let result = if entry.file_type().is_ok_and(|t| t.is_dir()) {
+            relabel_tree(path, con_buf)
+        } else {
+            relabel_if_unlabeled(path, con_buf)
+        };
+        path.truncate(len);
+        result?;
     }
     Ok(())
 }
 
-fn restore_syscon_if_unlabeled<P: AsRef<Path>>(dir: P) -> Result<()> {
-    for dir_entry in WalkDir::new(dir).parallelism(Serial) {
-        if let Some(path) = dir_entry.ok().map(|dir_entry| dir_entry.path())
-            && let anyhow::Result::Ok(con) = lgetfilecon(&path)
-            && (con == UNLABEL_CON || con.is_empty())
-        {
-            lsetfilecon(&path, SYSTEM_CON)?;
+/// Changes whenever the module is installed or updated again, or an OTA
+/// brings a new policy that may leave old labels unlabeled
+fn module_label_stamp(module: &Path, fingerprint: &str) -> Option<String> {
+    let meta = fs::metadata(module.join("module.prop")).ok()?;
+    Some(format!(
+        "{}.{}:{}:{fingerprint}",
+        meta.mtime(),
+        meta.mtime_nsec(),
+        meta.size()
+    ))
+}
+
+fn relabel_overlay(module: &Path, con_buf: &mut [u8]) -> Result<()> {
+    for dir in OVERLAY_DIRS {
+        let dir = module.join(dir);
+        // system/vendor and friends may be symlinks to the moved partition
+        if !fs::symlink_metadata(&dir).is_ok_and(|meta| meta.is_dir()) {
+            continue;
         }
+        relabel_tree(&mut dir.into_os_string().into_vec(), con_buf)?;
     }
     Ok(())
 }
 
+fn relabel_module(module: &Path, fingerprint: &str, con_buf: &mut [u8]) -> Result<()> {
+    let mut path = module.as_os_str().as_bytes().to_vec();
+    if !module.is_dir() || module.is_symlink() {
+        return relabel_if_unlabeled(&mut path, con_buf);
+    }
+
+    let stamp = module_label_stamp(module, fingerprint);
+    if let Some(stamp) = &stamp
+        && extattr::lgetxattr(module, LABEL_STAMP_XATTR).is_ok_and(|old| old == stamp.as_bytes())
+    {
+        relabel_if_unlabeled(&mut path, con_buf)?;
+        return relabel_overlay(module, con_buf);
+    }
+
+    relabel_tree(&mut path, con_buf)?;
+
+    if let Some(stamp) = stamp {
+        // best effort, without it we just walk again next boot
+        let _ = lsetxattr(module, LABEL_STAMP_XATTR, stamp, XattrFlags::empty());
+    }
+    Ok(())
+}
+
+fn restore_syscon_if_unlabeled<P: AsRef<Path>>(dir: P) -> Result<()> {
+    let dir = dir.as_ref();
+    let mut con_buf = [0u8; 256];
+    relabel_if_unlabeled(&mut dir.as_os_str().as_bytes().to_vec(), &mut con_buf)?;
+
+    let Some(entries) = fs::read_dir(dir).ok() else {
+        return Ok(());
+    };
+    let modules: Vec<PathBuf> = entries.flatten().map(|entry| entry.path()).collect();
+    let fingerprint = utils::getprop("ro.build.fingerprint").unwrap_or_default();
+    let next = AtomicUsize::new(0);
+    let jobs = thread::available_parallelism()
+        .map_or(1, std::num::NonZeroUsize::get)
+        .min(modules.len());
+
+    // one module at a time per worker, modules are independent trees
+    thread::scope(|scope| {
+        let workers: Vec<_> = (0..jobs)
+            .map(|_| {
+                scope.spawn(|| {
+                    let mut con_buf = [0u8; 256];
+                    while let Some(module) = modules.get(next.fetch_add(1, Ordering::Relaxed)) {
+                        relabel_module(module, &fingerprint, &mut con_buf)?;
+                    }
+                    Ok(())
+                })
+            })
+            .collect();
+        workers.into_iter().try_for_each(|worker| {
+            worker
+                .join()
+                .unwrap_or_else(|_| Err(anyhow!("restorecon worker panicked")))
+        })
+    })
+}
+
 pub fn restorecon() -> Result<()> {
     lsetfilecon(defs::DAEMON_PATH, ADB_CON)?;
     restore_syscon_if_unlabeled(defs::MODULE_DIR)?;
@@ -1,4 +1,9 @@
-use std::{ffi, path::Path, vec};
+use std::{
+    ffi,
+    io::{Read, Write},
+    path::Path,
+    vec,
+};
 
 use anyhow::{Result, bail};
 use derive_new::new;
@@ -379,7 +384,7 @@ const CMD_TYPE_TRANSITION: u32 = 7;
 const CMD_TYPE_CHANGE: u32 = 8;
 const CMD_GENFSCON: u32 = 9;
 
-#[derive(Debug, Default)]
+#[derive(Debug, Default, Clone, PartialEq, Eq, Hash)]
 enum PolicyObject {
     All, // for "*", stand for all objects, and is NULL in ffi
     One([u8; SEPOLICY_MAX_LEN]),
@@ -405,8 +410,8 @@ impl TryFrom<&str> for PolicyObject {
 /// allow domain1 domain2:file1 { read write }; would be expand to two atomic statement
 /// allow domain1 domain2:file1 read;allow domain1 domain2:file1 write;
 #[allow(clippy::too_many_arguments)]
-#[derive(Debug, new)]
-struct AtomicStatement {
+#[derive(Debug, Clone, PartialEq, Eq, Hash, new)]
+pub struct AtomicStatement {
     cmd: u32,
     subcmd: u32,
     sepol1: PolicyObject,
@@ -678,8 +683,8 @@ const fn to_c_ptr(pol: &PolicyObject) -> *const ffi::c_char {
     }
 }
 
-impl From<AtomicStatement> for FfiPolicy {
-    fn from(policy: AtomicStatement) -> Self {
+impl From<&AtomicStatement> for FfiPolicy {
+    fn from(policy: &AtomicStatement) -> Self {
         Self {
             cmd: policy.cmd,
             subcmd: policy.subcmd,
@@ -694,16 +699,21 @@ impl From<AtomicStatement> for FfiPolicy {
     }
 }
 
+fn apply_atomic(policy: &AtomicStatement) -> std::io::Result<()> {
+    // the pointers borrow from `policy`, which outlives the ioctl
+    let ffi_policy = FfiPolicy::from(policy);
+    let cmd = ksucalls::SetSepolicyCmd {
+        cmd: 0,
+        arg: &raw const ffi_policy as u64,
+    };
+    ksucalls::set_sepolicy(&cmd)
+}
+
 fn apply_one_rule<'a>(statement: &'a PolicyStatement<'a>, strict: bool) -> Result<()> {
     let policies: Vec<AtomicStatement> = statement.try_into()?;
 
     for policy in policies {
-        let ffi_policy = FfiPolicy::from(policy);
-        let cmd = ksucalls::SetSepolicyCmd {
-            cmd: 0,
-            arg: &raw const ffi_policy as u64,
-        };
-        if let Err(e) = ksucalls::set_sepolicy(&cmd) {
+        if let Err(e) = apply_atomic(&policy) {
             log::warn!("apply rule {statement:?} failed: {e}");
             if strict {
                 return Err(anyhow::anyhow!("apply rule {statement:?} failed: {e}"));
@@ -728,6 +738,96 @@ pub fn apply_file<P: AsRef<Path>>(path: P) -> Result<()> {
     live_patch(&input)
 }
 
+/// Parse and expand `policy` the way `live_patch` would, without applying it.
+/// Like `live_patch`, a statement that can't be expanded ends the input.
+pub fn compile(policy: &str) -> Result<Vec<AtomicStatement>> {
+    let mut result = vec![];
+    for statement in parse_sepolicy(policy.trim(), false)? {
+        match Vec::<AtomicStatement>::try_from(&statement) {
+            Ok(policies) => result.extend(policies),
+            Err(e) => {
+                log::warn!("compile rule {statement:?} failed: {e}");
+                break;
+            }
+        }
+    }
+    Ok(result)
+}
+
+impl AtomicStatement {
+    /// `type`, `attribute` and `typeattribute`: later rules may depend on them
+    pub fn is_declaration(&self) -> bool {
+        matches!(self.cmd, CMD_TYPE | CMD_TYPE_ATTR | CMD_ATTR)
+    }
+
+    pub fn apply(&self) {
+        if let Err(e) = apply_atomic(self) {
+            log::warn!("apply rule {self:?} failed: {e}");
+        }
+    }
+
+    fn objects(&self) -> [&PolicyObject; 7] {
+        [
+            &self.sepol1,
+            &self.sepol2,
+            &self.sepol3,
+            &self.sepol4,
+            &self.sepol5,
+            &self.sepol6,
+            &self.sepol7,
+        ]
+    }
+
+    pub fn write_to(&self, writer: &mut impl Write) -> std::io::Result<()> {
+        writer.write_all(&self.cmd.to_le_bytes())?;
+        writer.write_all(&self.subcmd.to_le_bytes())?;
+        for object in self.objects() {
+            match object {
+                PolicyObject::None => writer.write_all(&[0])?,
+                PolicyObject::All => writer.write_all(&[1])?,
+                PolicyObject::One(buf) => {
+                    let len = buf.iter().position(|&b| b == 0).unwrap_or(buf.len());
+                    writer.write_all(&[2, len as u8])?;
+                    writer.write_all(&buf[..len])?;
+                }
+            }
+        }
+        Ok(())
+    }
+
+    pub fn read_from(reader: &mut impl Read) -> Result<Self> {
+        let mut word = [0u8; 4];
+        reader.read_exact(&mut word)?;
+        let cmd = u32::from_le_bytes(word);
+        reader.read_exact(&mut word)?;
+        let subcmd = u32::from_le_bytes(word);
+
+        let mut objects: [PolicyObject; 7] = Default::default();
+        for object in &mut objects {
+            let mut tag = [0u8; 2];
+            reader.read_exact(&mut tag[..1])?;
+            *object = match tag[0] {
+                0 => PolicyObject::None,
+                1 => PolicyObject::All,
+                2 => {
+                    reader.read_exact(&mut tag[1..])?;
+                    let len = tag[1] as usize;
+                    anyhow::ensure!(len <= SEPOLICY_MAX_LEN, "policy object too long");
+                    let mut buf = [0u8; SEPOLICY_MAX_LEN];
+                    reader.read_exact(&mut buf[..len])?;
+                    PolicyObject::One(buf)
+                }
+                other => bail!("invalid policy object tag {other}"),
+            };
+        }
+
+        let [sepol1, sepol2, sepol3, sepol4, sepol5, sepol6, sepol7] = objects;
+        Ok(Self::new(
+            cmd, subcmd, sepol1, sepol2, sepol3, sepol4, sepol5, sepol6, sepol7,
+        ))
+    }
+}
+
 pub fn check_rule(policy: &str) -> Result<()> {
     let path = Path::new(policy);
     let policy = if path.exists() {
@@ -0,0 +1,180 @@
+//! Compiled sepolicy cache
+//!
+//! Module sepolicy.rule files and root profile policies used to be parsed
+//! with the nom grammar on every boot. All sources are now hashed together
+//! instead. When the hash matches the cache, the atomic statements stored in
+//! it are sent to the kernel as they are. When it doesn't, every source is
+//! compiled again and the cache is rewritten. Compiling also drops duplicate
+//! statements. Declarations keep their first copy, so a rule can never end
+//! up before a type or attribute it uses. Every other statement keeps its
+//! last copy, so the final outcome of allow/deny sequences is unchanged.
+
+use std::{
+    collections::HashSet,
+    fs::{self, File},
+    io::{BufReader, BufWriter, Read, Write},
+    path::{Path, PathBuf},
+};
+
+use anyhow::{Result, bail};
+use const_format::concatcp;
+use log::{info, warn};
+
+use crate::{
+    android::{
+        module,
+        sepolicy::{self, AtomicStatement},
+    },
+    defs,
+};
+
+const CACHE_PATH: &str = concatcp!(defs::WORKING_DIR, ".sepolicy_cache");
+const CACHE_MAGIC: u32 = 0x4B53_5043; // KSPC
+const CACHE_VERSION: u32 = 2;
+
+struct Source {
+    path: PathBuf,
+    content: String,
+}
+
+fn sorted_files(dir: &Path) -> Vec<PathBuf> {
+    let Ok(entries) = fs::read_dir(dir) else {
+        return Vec::new();
+    };
+    let mut files: Vec<PathBuf> = entries.flatten().map(|entry| entry.path()).collect();
+    files.sort();
+    files
+}
+
+/// Module rules first, then profile policies, each in path order
+fn collect_sources() -> Vec<Source> {
+    let mut paths = Vec::new();
+    let _ = module::foreach_active_module(|module| {
+        let rule_file = module.join("sepolicy.rule");
+        if rule_file.exists() {
+            paths.push(rule_file);
+        }
+        Ok(())
+    });
+    paths.sort();
+    paths.extend(sorted_files(Path::new(defs::PROFILE_SELINUX_DIR)));
+
+    paths
+        .into_iter()
+        .filter_map(|path| match fs::read_to_string(&path) {
+            Ok(content) => Some(Source { path, content }),
+            Err(e) => {
+                warn!("Failed to read {}: {e}", path.display());
+                None
+            }
+        })
+        .collect()
+}
+
+fn digest(sources: &[Source]) -> String {
+    let mut data = Vec::new();
+    for source in sources {
+        data.extend_from_slice(source.path.as_os_str().as_encoded_bytes());
+        data.push(0);
+        data.extend_from_slice(&(source.content.len() as u64).to_le_bytes());
+        data.extend_from_slice(source.content.as_bytes());
+    }
+    sha256::digest(&data)
+}
+
+fn compile(sources: &[Source]) -> Vec<AtomicStatement> {
+    let mut all = Vec::new();
+    for source in sources {
+        info!("compile policy: {}", source.path.display());
+        match sepolicy::compile(&source.content) {
+            Ok(statements) => all.extend(statements),
+            Err(e) => warn!("Failed to compile {}: {e}", source.path.display()),
+        }
+    }
+
+    // first copy of each declaration, last copy of everything else, in order
+    let mut declared = HashSet::new();
+    let all: Vec<AtomicStatement> = all
+        .into_iter()
+        .filter(|statement| !statement.is_declaration() || declared.insert(statement.clone()))
+        .collect();
+    let mut seen = HashSet::with_capacity(all.len());
+    let mut rules: Vec<AtomicStatement> = all
+        .into_iter()
+        .rev()
+        .filter(|statement| statement.is_declaration() || seen.insert(statement.clone()))
+        .collect();
+    rules.reverse();
+    rules
+}
+
+fn read_u32(reader: &mut impl Read) -> std::io::Result<u32> {
+    let mut buf = [0u8; 4];
+    reader.read_exact(&mut buf)?;
+    Ok(u32::from_le_bytes(buf))
+}
+
+fn load_cache(digest: &str) -> Result<Vec<AtomicStatement>> {
+    let mut reader = BufReader::new(File::open(CACHE_PATH)?);
+
+    if read_u32(&mut reader)? != CACHE_MAGIC || read_u32(&mut reader)? != CACHE_VERSION {
+        bail!("Invalid sepolicy cache header");
+    }
+
+    let mut cached = vec![0u8; digest.len()];
+    reader.read_exact(&mut cached)?;
+    if cached != digest.as_bytes() {
+        bail!("sepolicy sources changed");
+    }
+
+    let count = read_u32(&mut reader)?;
+    let mut rules = Vec::with_capacity(count as usize);
+    for _ in 0..count {
+        rules.push(AtomicStatement::read_from(&mut reader)?);
+    }
+    Ok(rules)
+}
+
+fn save_cache(digest: &str, rules: &[AtomicStatement]) -> Result<()> {
+    let temp_path = concatcp!(CACHE_PATH, ".tmp");
+    let mut writer = BufWriter::new(File::create(temp_path)?);
+
+    writer.write_all(&CACHE_MAGIC.to_le_bytes())?;
+    writer.write_all(&CACHE_VERSION.to_le_bytes())?;
+    writer.write_all(digest.as_bytes())?;
+    writer.write_all(&(rules.len() as u32).to_le_bytes())?;
+    for rule in rules {
+        rule.write_to(&mut writer)?;
+    }
+    writer.flush()?;
+    drop(writer);
+
+    fs::rename(temp_path, CACHE_PATH)?;
+    Ok(())
+}
+
+/// Apply module sepolicy.rule files and root profile policies
+pub fn apply() -> Result<()> {
+    let sources = collect_sources();
+    let digest = digest(&sources);
+
+    let rules = match load_cache(&digest) {
+        Ok(rules) => {
+            info!("sepolicy cache hit, {} rules", rules.len());
+            rules
+        }
+        Err(e) => {
+            info!("sepolicy cache miss: {e}");
+            let rules = compile(&sources);
+            if let Err(e) = save_cache(&digest, &rules) {
+                warn!("Failed to save sepolicy cache: {e}");
+            }
+            rules
+        }
+    };
+
+    for rule in &rules {
+        rule.apply();
+    }
+    Ok(())
+}
@@ -12,6 +12,38 @@ use crate::{android::ksucalls, defs};
 // Magic number for umount config file
 const UMOUNT_CONFIG_MAGIC: u32 = 0x4B53_554D; // KSUM
 
+/// Read (path, flags) records following the magic number
+fn read_entries(reader: &mut impl Read) -> Result<Vec<(String, u32)>> {
+    let mut entries = Vec::new();
+    loop {
+        // Read path length
+        let mut len_buf = [0u8; 4];
+        match reader.read_exact(&mut len_buf) {
+            Ok(()) => {}
+            Err(e) if e.kind() == std::io::ErrorKind::UnexpectedEof => break,
+            Err(e) => return Err(e.into()),
+        }
+        let path_len = u32::from_le_bytes(len_buf) as usize;
+
+        // Read path
+        let mut path_buf = vec![0u8; path_len];
+        reader
+            .read_exact(&mut path_buf)
+            .context("Failed to read path")?;
+        let path = String::from_utf8(path_buf).context("Invalid UTF-8 in path")?;
+
+        // Read flags
+        let mut flags_buf = [0u8; 4];
+        reader
+            .read_exact(&mut flags_buf)
+            .context("Failed to read flags")?;
+        let flags = u32::from_le_bytes(flags_buf);
+
+        entries.push((path, flags));
+    }
+    Ok(entries)
+}
+
 pub fn save_umount_config() -> Result<()> {
     let list_output =
         ksucalls::umount_list_list().context("Failed to get umount list from kernel")?;
@@ -73,41 +105,9 @@ pub fn load_umount_config() -> Result<()> {
         return Ok(());
     }
 
-    // Wipe existing list first
-    ksucalls::umount_list_wipe().context("Failed to wipe existing umount list")?;
-
-    // Read entries
-    let mut count = 0;
-    loop {
-        // Read path length
-        let mut len_buf = [0u8; 4];
-        match reader.read_exact(&mut len_buf) {
-            Ok(()) => {}
-            Err(e) if e.kind() == std::io::ErrorKind::UnexpectedEof => break,
-            Err(e) => return Err(e.into()),
-        }
-        let path_len = u32::from_le_bytes(len_buf) as usize;
-
-        // Read path
-        let mut path_buf = vec![0u8; path_len];
-        reader
-            .read_exact(&mut path_buf)
-            .context("Failed to read path")?;
-        let path = String::from_utf8(path_buf).context("Invalid UTF-8 in path")?;
-
-        // Read flags
-        let mut flags_buf = [0u8; 4];
-        reader
-            .read_exact(&mut flags_buf)
-            .context("Failed to read flags")?;
-        let flags = u32::from_le_bytes(flags_buf);
-
-        // Add to kernel list
-        ksucalls::umount_list_add(&path, flags)
-            .with_context(|| format!("Failed to add umount path: {path}"))?;
-
-        count += 1;
-    }
+    let entries = read_entries(&mut reader)?;
+    let count =
+        ksucalls::umount_list_set(&entries).context("Failed to load umount entries into kernel")?;
 
     info!("Loaded {count} umount entries from config");
     Ok(())
@@ -138,30 +138,7 @@ pub fn remove_umount_entry_from_config(target_path: &str) -> Result<()> {
         return Ok(());
     }
 
-    let mut entries: Vec<(String, u32)> = Vec::new();
-    loop {
-        let mut len_buf = [0u8; 4];
-        match reader.read_exact(&mut len_buf) {
-            Ok(()) => {}
-            Err(e) if e.kind() == std::io::ErrorKind::UnexpectedEof => break,
-            Err(e) => return Err(e.into()),
-        }
-        let path_len = u32::from_le_bytes(len_buf) as usize;
-
-        let mut path_buf = vec![0u8; path_len];
-        reader
-            .read_exact(&mut path_buf)
-            .context("Failed to read path")?;
-        let path = String::from_utf8(path_buf).context("Invalid UTF-8 in path")?;
-
-        let mut flags_buf = [0u8; 4];
-        reader
-            .read_exact(&mut flags_buf)
-            .context("Failed to read flags")?;
-        let flags = u32::from_le_bytes(flags_buf);
-
-        entries.push((path, flags));
-    }
+    let mut entries = read_entries(&mut reader)?;
 
     let original_len = entries.len();
     entries.retain(|(p, _)| p != target_path);
@@ -4,6 +4,7 @@ use std::os::unix::fs::PermissionsExt;
 use std::{
     path::{Path, PathBuf},
     process::{Command, Stdio},
+    time::Instant,
 };
 
 use anyhow::{Context, Result, bail, ensure};
@@ -15,8 +16,11 @@ use crate::assets;
 #[cfg(target_os = "android")]
 mod android {
     use std::{
+        fs::{File, OpenOptions},
+        io::{Read, Seek, SeekFrom, Write},
+        os::unix::fs::FileExt,
         path::{Path, PathBuf},
-        process::{Command, Stdio},
+        process::Command,
     };
 
     use anyhow::{Context, anyhow, bail, ensure};
@@ -93,39 +97,65 @@ mod android {
         parse_kmi_from_uname().or_else(|_| parse_kmi_from_modules())
     }
 
-    fn calculate_sha1(file_path: impl AsRef<Path>) -> Result<String> {
-        use std::io::Read;
+    const IO_CHUNK: usize = 1 << 20;
 
+    /// Hash `src`, copying it to `dst` in the same pass when given
+    fn sha1_copy(src: &Path, dst: Option<&Path>) -> Result<String> {
         use sha1::Digest;
-        let mut file = std::fs::File::open(file_path.as_ref())?;
+
+        let mut input = File::open(src).with_context(|| format!("open {}", src.display()))?;
+        let mut output = dst
+            .map(|dst| File::create(dst).with_context(|| format!("create {}", dst.display())))
+            .transpose()?;
         let mut hasher = sha1::Sha1::new();
-        let mut buffer = [0; 1024];
+        let mut buffer = vec![0u8; IO_CHUNK];
 
         loop {
-            let n = file.read(&mut buffer)?;
+            let n = input.read(&mut buffer)?;
             if n == 0 {
                 break;
             }
             hasher.update(&buffer[..n]);
+            if let Some(output) = output.as_mut() {
+                output.write_all(&buffer[..n])?;
+            }
         }
 
         let result = hasher.finalize();
         Ok(format!("{result:x}"))
     }
 
+    /// Pull the partition into `image`, returning its sha1
+    pub(super) fn read_partition(bootdevice: &str, image: &Path) -> Result<String> {
+        sha1_copy(Path::new(bootdevice), Some(image))
+            .with_context(|| format!("read {bootdevice} failed"))
+    }
+
     pub(super) fn do_backup(
         magiskboot: &Path,
         workdir: &Path,
         cpio_path: &Path,
         image: &Path,
+        sha1: Option<&str>,
     ) -> Result<()> {
-        let sha1 = calculate_sha1(image)?;
+        let sha1 = match sha1 {
+            Some(sha1) => sha1.to_string(),
+            None => sha1_copy(image, None)?,
+        };
         let filename = format!("{KSU_BACKUP_FILE_PREFIX}{sha1}");
 
         println!("- Backup stock boot image");
         // magiskboot cpio ramdisk.cpio 'add 0755 $BACKUP_FILENAME'
         let target = format!("{KSU_BACKUP_DIR}{filename}");
-        std::fs::copy(image, &target).with_context(|| format!("backup to {target}"))?;
+        // the image we pulled off the device is only read by magiskboot, so
+        // the backup can share it instead of being another full copy
+        // the old backup stays in place until the new one is complete
+        let temp = format!("{target}.tmp");
+        let _ = std::fs::remove_file(&temp);
+        if !image.starts_with(workdir) || std::fs::hard_link(image, &temp).is_err() {
+            std::fs::copy(image, &temp).with_context(|| format!("backup to {temp}"))?;
+        }
+        std::fs::rename(&temp, &target).with_context(|| format!("backup to {target}"))?;
         std::fs::write(workdir.join(BACKUP_FILENAME), sha1.as_bytes()).context("write sha1")?;
         do_cpio_cmd(
             magiskboot,
@@ -169,7 +199,41 @@ mod android {
             .arg(bootdevice)
             .status()?;
         ensure!(status.success(), "set boot device rw failed");
-        dd(new_boot, bootdevice).context("flash boot failed")?;
+        write_changed_blocks(&new_boot, Path::new(bootdevice)).context("flash boot failed")?;
+        Ok(())
+    }
+
+    /// Write `image` over `device`, skipping chunks that already match
+    fn write_changed_blocks(image: &Path, device: &Path) -> Result<()> {
+        let mut input = File::open(image)?;
+        let mut output = OpenOptions::new().read(true).write(true).open(device)?;
+        let size = input.metadata()?.len();
+        let capacity = output.seek(SeekFrom::End(0))?;
+        ensure!(
+            size <= capacity,
+            "image is larger than the partition ({size} > {capacity})"
+        );
+
+        let mut new = vec![0u8; IO_CHUNK];
+        let mut old = vec![0u8; IO_CHUNK];
+        let (mut offset, mut written) = (0u64, 0u64);
+        while offset < size {
+            let len = usize::try_from(size - offset).map_or(IO_CHUNK, |left| left.min(IO_CHUNK));
+            input.read_exact(&mut new[..len])?;
+            output.read_exact_at(&mut old[..len], offset)?;
+            if new[..len] != old[..len] {
+                output.write_all_at(&new[..len], offset)?;
+                written += len as u64;
+            }
+            offset += len as u64;
+        }
+        output.sync_all()?;
+
+        println!(
+            "- Wrote {} of {} KiB",
+            written.div_ceil(1024),
+            size.div_ceil(1024)
+        );
         Ok(())
     }
 
@@ -260,22 +324,6 @@ rm -f /data/adb/post-fs-data.d/post_ota.sh
 
         Ok(())
     }
-
-    pub(super) fn dd<P: AsRef<Path>, Q: AsRef<Path>>(ifile: P, ofile: Q) -> Result<()> {
-        let status = Command::new("dd")
-            .stdout(Stdio::null())
-            .stderr(Stdio::null())
-            .arg(format!("if={}", ifile.as_ref().display()))
-            .arg(format!("of={}", ofile.as_ref().display()))
-            .status()?;
-        ensure!(
-            status.success(),
-            "dd if={} of={} failed",
-            ifile.as_ref().display(),
-            ofile.as_ref().display()
-        );
-        Ok(())
-    }
 }
 
 #[cfg(target_os = "android")]
@@ -401,6 +449,14 @@ fn find_magiskboot(magiskboot_path: Option<PathBuf>, workdir: &Path) -> Result<P
     Ok(magiskboot)
 }
 
+#[cfg_attr(not(target_os = "android"), allow(dead_code))]
+struct BootImage {
+    path: PathBuf,
+    device: Option<String>,
+    /// sha1 of the image, when it was hashed while being read off the device
+    sha1: Option<String>,
+}
+
 fn find_boot_image(
     image: &Option<PathBuf>,
     kmi: &str,
@@ -408,9 +464,10 @@ fn find_boot_image(
     is_replace_kernel: bool,
     workdir: &Path,
     partition: &Option<String>,
-) -> Result<(PathBuf, Option<String>)> {
+) -> Result<BootImage> {
     let bootimage;
     let mut bootdevice = None;
+    let mut sha1 = None;
     if let Some(ref image) = *image {
         ensure!(image.exists(), "boot image not found");
         bootimage = std::fs::canonicalize(image)?;
@@ -430,15 +487,17 @@ fn find_boot_image(
             println!("- Bootdevice: {boot_partition}");
             let tmp_boot_path = workdir.join("boot.img");
 
-            dd(&boot_partition, &tmp_boot_path)?;
-
-            ensure!(tmp_boot_path.exists(), "boot image not found");
+            sha1 = Some(read_partition(&boot_partition, &tmp_boot_path)?);
 
             bootimage = tmp_boot_path;
             bootdevice = Some(boot_partition);
         }
     }
-    Ok((bootimage, bootdevice))
+    Ok(BootImage {
+        path: bootimage,
+        device: bootdevice,
+        sha1,
+    })
 }
 
 #[derive(clap::Args, Debug)]
@@ -492,6 +551,7 @@ pub struct BootPatchArgs {
 }
 
 pub fn patch(args: BootPatchArgs) -> Result<()> {
+    let start = Instant::now();
     let inner = move || {
         let BootPatchArgs {
             boot: image,
@@ -570,14 +630,12 @@ pub fn patch(args: BootPatchArgs) -> Result<()> {
         )?;
 
         #[cfg(target_os = "android")]
-        let (bootimage, bootdevice) =
-            find_boot_image(&image, &kmi, ota, is_replace_kernel, workdir, &partition)?;
+        let boot = find_boot_image(&image, &kmi, ota, is_replace_kernel, workdir, &partition)?;
 
         #[cfg(not(target_os = "android"))]
-        let (bootimage, _) =
-            find_boot_image(&image, &kmi, false, is_replace_kernel, workdir, &None)?;
+        let boot = find_boot_image(&image, &kmi, false, is_replace_kernel, workdir, &None)?;
 
-        let bootimage = bootimage.as_path();
+        let bootimage = boot.path.as_path();
 
         // try extract magiskboot/bootctl
         #[cfg(target_os = "android")]
@@ -654,7 +712,13 @@ pub fn patch(args: BootPatchArgs) -> Result<()> {
         #[cfg(target_os = "android")]
         if !is_kernelsu_patched
             && flash
-            && let Err(e) = do_backup(&magiskboot, workdir, ramdisk, bootimage)
+            && let Err(e) = do_backup(
+                &magiskboot,
+                workdir,
+                ramdisk,
+                bootimage,
+                boot.sha1.as_deref(),
+            )
         {
             println!("- Backup stock image failed: {e}");
         }
@@ -689,14 +753,14 @@ pub fn patch(args: BootPatchArgs) -> Result<()> {
         #[cfg(target_os = "android")]
         if flash {
             println!("- Flashing new boot image");
-            flash_boot(&bootdevice, new_boot)?;
+            flash_boot(&boot.device, new_boot)?;
 
             if ota {
                 post_ota()?;
             }
         }
 
-        println!("- Done!");
+        println!("- Done in {:.1}s!", start.elapsed().as_secs_f32());
         Ok(())
     };
 
@@ -748,9 +812,15 @@ pub fn restore(args: BootRestoreArgs) -> Result<()> {
     let kmi = get_current_kmi().unwrap_or_default();
 
     #[cfg(target_os = "android")]
-    let (bootimage, bootdevice) = find_boot_image(&image, &kmi, false, false, workdir, &None)?;
+    let BootImage {
+        path: bootimage,
+        device: bootdevice,
+        ..
+    } = find_boot_image(&image, &kmi, false, false, workdir, &None)?;
     #[cfg(not(target_os = "android"))]
-    let (bootimage, _) = find_boot_image(&image, "", false, false, workdir, &None)?;
+    let BootImage {
+        path: bootimage, ..
+    } = find_boot_image(&image, "", false, false, workdir, &None)?;
 
     println!("- Unpacking boot image");
     let status = Command::new(&magiskboot)
@@ -43,6 +43,8 @@ mod android {
     pub const UMOUNT_CONFIG_PATH: &str = concatcp!(WORKING_DIR, ".umount");
 
     pub const EXEC_STAGE_TIMEOUT: std::time::Duration = std::time::Duration::from_secs(10);
+    // total time init is held for module post-fs-data scripts
+    pub const POST_FS_DATA_BUDGET: std::time::Duration = std::time::Duration::from_secs(30);
 
     pub const DYNAMIC_MANAGER: &str = concatcp!(WORKING_DIR, ".dynamic_manager");
 }
@@ -3,7 +3,8 @@ use goblin::elf::{Elf, section_header, sym::Sym};
 use rustix::{cstr, system::init_module};
 use scroll::{Pwrite, ctx::SizeWith};
 use std::collections::HashMap;
-use std::fs;
+use std::fs::{self, File};
+use std::io::{BufRead, BufReader};
 
 struct Kptr {
     value: String,
@@ -23,31 +24,45 @@ impl Drop for Kptr {
     }
 }
 
-fn parse_kallsyms() -> Result<HashMap<String, u64>> {
-    let _dontdrop = Kptr::new()?;
+/// Address and name of a /proc/kallsyms line, with the `$` and `.llvm.`
+/// suffixes compilers add to local symbols stripped
+fn parse_kallsyms_line(line: &[u8]) -> Option<(u64, &str)> {
+    let line = std::str::from_utf8(line).ok()?;
+    let mut splits = line.split_ascii_whitespace();
+    let addr = u64::from_str_radix(splits.next()?, 16).ok()?;
+    let symbol = splits.nth(1)?;
+    let symbol = symbol
+        .find('$')
+        .or_else(|| symbol.find(".llvm."))
+        .map_or(symbol, |pos| &symbol[0..pos]);
+    Some((addr, symbol))
+}
 
-    let allsyms = fs::read_to_string("/proc/kallsyms")?
-        .lines()
-        .map(|line| line.split_whitespace())
-        .filter_map(|mut splits| {
-            splits
-                .next()
-                .and_then(|addr| u64::from_str_radix(addr, 16).ok())
-                .and_then(|addr| splits.nth(1).map(|symbol| (symbol, addr)))
-        })
-        .map(|(symbol, addr)| {
-            (
-                symbol
-                    .find("$")
-                    .or_else(|| symbol.find(".llvm."))
-                    .map_or(symbol, |pos| &symbol[0..pos])
-                    .to_owned(),
-                addr,
-            )
-        })
-        .collect::<HashMap<_, _>>();
+/// Fill in the address of every symbol in `wanted` in one streaming pass,
+/// stopping as soon as the last one is found. The first occurrence wins, so
+/// vmlinux symbols take precedence over same-named module symbols.
+fn resolve_kallsyms(
+    mut reader: impl BufRead,
+    wanted: &mut HashMap<&str, Option<u64>>,
+) -> Result<()> {
+    let mut remaining = wanted.len();
+    let mut line = Vec::with_capacity(256);
 
-    Ok(allsyms)
+    while remaining > 0 {
+        line.clear();
+        if reader.read_until(b'\n', &mut line)? == 0 {
+            break;
+        }
+        let Some((addr, symbol)) = parse_kallsyms_line(&line) else {
+            continue;
+        };
+        if let Some(slot @ None) = wanted.get_mut(symbol) {
+            *slot = Some(addr);
+            remaining -= 1;
+        }
+    }
+
+    Ok(())
 }
 
 pub fn load_module(path: &str) -> Result<()> {
@@ -59,29 +74,35 @@ pub fn load_module(path: &str) -> Result<()> {
     let mut buffer = fs::read(path).with_context(|| format!("Cannot read file {}", path))?;
     let elf = Elf::parse(&buffer)?;
 
-    let kernel_symbols = parse_kallsyms().context("Cannot parse kallsyms")?;
-
-    let mut modifications = Vec::new();
-    for (index, mut sym) in elf.syms.iter().enumerate() {
-        if index == 0 {
+    // the handful of symbols kernelsu.ko needs, resolved before touching kallsyms
+    let mut undefined = Vec::new();
+    for (index, sym) in elf.syms.iter().enumerate() {
+        if index == 0 || sym.st_shndx != section_header::SHN_UNDEF as usize {
             continue;
         }
-
-        if sym.st_shndx != section_header::SHN_UNDEF as usize {
-            continue;
+        if let Some(name) = elf.strtab.get_at(sym.st_name) {
+            undefined.push((index, sym, name));
         }
+    }
 
-        let Some(name) = elf.strtab.get_at(sym.st_name) else {
-            continue;
-        };
+    let mut wanted: HashMap<&str, Option<u64>> =
+        undefined.iter().map(|&(_, _, name)| (name, None)).collect();
+    {
+        let _dontdrop = Kptr::new()?;
+        let kallsyms = File::open("/proc/kallsyms").context("Cannot open kallsyms")?;
+        resolve_kallsyms(BufReader::with_capacity(64 * 1024, kallsyms), &mut wanted)
+            .context("Cannot parse kallsyms")?;
+    }
 
+    let mut modifications = Vec::new();
+    for (index, mut sym, name) in undefined {
         let offset = elf.syms.offset() + index * Sym::size_with(elf.syms.ctx());
-        let Some(real_addr) = kernel_symbols.get(name) else {
+        let Some(real_addr) = wanted.get(name).copied().flatten() else {
             log::warn!("Cannot find symbol: {}", &name);
             continue;
         };
         sym.st_shndx = section_header::SHN_ABS as usize;
-        sym.st_value = *real_addr;
+        sym.st_value = real_addr;
         modifications.push((sym, offset));
     }
 